@@ -0,0 +1,169 @@
+//  PZ compressor, sorted accumulator
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements an LSM style accumulator of sorted runs
+//
+//  Each pushed batch is padded with INT32_MAX to a multiple of 16, sorted
+//  with the SSE2 register sort and bitonic merges and stacked as a run.
+//  Padding sorts last, so the first n keys of a run are always its keys.
+//  The run stack is kept with decreasing size tiers (log2 of vectors);
+//  a run reaching the tier of the one below is merged with it.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sse2.h"
+#include "pz.h"
+
+struct run {
+    v4si  *v;       // Sorted vectors (last one padded)
+    int    n;       // Number of keys
+};
+
+struct pz_acc {
+    struct run *runs;   // Stack of runs, largest at the bottom
+    int         nruns;
+    int         maxruns;
+    v4si       *aux;    // Ping-pong buffer for sorting batches
+    int         auxlen; // in vectors
+};
+
+// Vectors used by n keys
+static int run_vectors(int n) {
+    return (n + 3) / 4;
+}
+
+// Size tier of a run
+static int run_tier(struct run *r) {
+    int v = run_vectors(r->n), t = 0;
+
+    while (v >>= 1)
+        t++;
+
+    return t;
+}
+
+pz_acc *pz_acc_new(void) {
+    return calloc(1, sizeof (pz_acc));
+}
+
+void pz_acc_free(pz_acc *acc) {
+    int i;
+
+    if (!acc)
+        return;
+
+    for (i = 0; i < acc->nruns; i++)
+        _mm_free(acc->runs[i].v);
+    free(acc->runs);
+    _mm_free(acc->aux);
+    free(acc);
+}
+
+// Merge the two runs on top of the stack
+static int merge_top(pz_acc *acc) {
+    struct run *a = &acc->runs[acc->nruns - 2];
+    struct run *b = &acc->runs[acc->nruns - 1];
+    int   la = run_vectors(a->n), lb = run_vectors(b->n);
+    v4si *v;
+
+    v = _mm_malloc((la + lb) * sizeof (v4si), 16);
+    if (!v)
+        return -1;
+
+    merge_2run_sse2(v, a->v, la, b->v, lb);
+
+    _mm_free(a->v);
+    _mm_free(b->v);
+    a->v = v; // Padding of both ends up at the tail
+    a->n += b->n;
+    acc->nruns--;
+
+    return 0;
+}
+
+int pz_acc_push(pz_acc *acc, const int32_t *batch, int n) {
+    struct run *r;
+    int32_t    *p;
+    v4si       *v, *sorted;
+    int         len, i;
+
+    if (n <= 0)
+        return 0;
+
+    len = ((n + 15) & ~15) / 4; // Sort works on groups of 4x4
+
+    if (acc->nruns == acc->maxruns) {
+        r = realloc(acc->runs, (acc->maxruns + 8) * sizeof (struct run));
+        if (!r)
+            return -1;
+        acc->runs = r;
+        acc->maxruns += 8;
+    }
+
+    if (acc->auxlen < len) {
+        _mm_free(acc->aux);
+        acc->auxlen = 0;
+        acc->aux = _mm_malloc(len * sizeof (v4si), 16);
+        if (!acc->aux)
+            return -1;
+        acc->auxlen = len;
+    }
+
+    v = _mm_malloc(len * sizeof (v4si), 16);
+    if (!v)
+        return -1;
+
+    p = (int32_t *) v;
+    memcpy(p, batch, n * sizeof (int32_t));
+    for (i = n; i < len * 4; i++)
+        p[i] = INT32_MAX;
+
+    sorted = sort_4si_sse2(v, acc->aux, len);
+    if (sorted != v) { // Keep the sorted buffer, reuse the other as aux
+        acc->aux = v;
+        acc->auxlen = len;
+        v = sorted;
+    }
+
+    r = &acc->runs[acc->nruns++];
+    r->v = v;
+    r->n = n;
+
+    // Size-tiered merge
+    while (acc->nruns > 1 && run_tier(&acc->runs[acc->nruns - 1]) >=
+            run_tier(&acc->runs[acc->nruns - 2]))
+        if (merge_top(acc) != 0)
+            return -1;
+
+    return 0;
+}
+
+int pz_acc_view(pz_acc *acc, const int32_t **keys) {
+
+    *keys = NULL;
+    if (acc->nruns == 0)
+        return 0;
+
+    // Lazy merge, smallest runs first
+    while (acc->nruns > 1)
+        if (merge_top(acc) != 0)
+            return -1;
+
+    *keys = (const int32_t *) acc->runs[0].v;
+
+    return acc->runs[0].n;
+}
@@ -0,0 +1,442 @@
+//  PZ compressor, benchmarks
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file measures throughput of the compressor stages
+//
+//  Usage: bench [file]  (without a file, 1MB of synthetic logs)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pz.h"
+
+#define HC_BITS 16 // Hash chain baseline table
+#define LZ_BLOCK PZ_LZ_MAX_BLOCK
+#define MSG 4096 // Small message size for stream latency
+#define MSGS 256
+
+static double now(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Synthetic web server logs with JSON payloads
+static int make_logs(uint8_t *d, int n) {
+    static const char *path[] = { "/", "/index.html", "/api/v1/users",
+        "/api/v1/items", "/static/app.js", "/login" };
+    static const char *agent[] = { "curl/7.68.0", "Mozilla/5.0 (X11)",
+        "python-requests/2.25" };
+    char line[256];
+    int  i = 0, l, t = 1300000000;
+
+    while (i < n) {
+        t += random() % 3;
+        l = snprintf(line, sizeof (line),
+                "10.0.%d.%d - - [%d] \"GET %s HTTP/1.1\" %d %d \"%s\" "
+                "{\"id\": %d, \"ok\": %s}\n",
+                (int) (random() % 4), (int) (random() % 256), t,
+                path[random() % 6], random() % 8 ? 200 : 404,
+                (int) (random() % 5000), agent[random() % 3],
+                (int) (random() % 100000), random() % 2 ? "true" : "false");
+        if (l > n - i)
+            l = n - i;
+        memcpy(d + i, line, l);
+        i += l;
+    }
+
+    return n;
+}
+
+//
+// LZ stage: sorted finder and a hash chain baseline, parsed greedily and
+// coded (literals and sequences) by pz
+//
+
+// Drain all pending output of s to out, returns bytes or -1
+static int drain_all(pz_stream *s, uint8_t *out, int max) {
+    int o = 0, k;
+
+    while ((k = pz_drain(s, out + o, max - o)) > 0)
+        o += k;
+
+    return k < 0 ? -1 : o;
+}
+
+// Compress n bytes of d in one stream, returns bytes written or -1
+static int compress_all(const uint8_t *d, int n, uint8_t *z, int max) {
+    pz_stream *c = pz_init(PZ_COMPRESS, 0);
+    int        i, k, nz = 0, o;
+
+    if (!c)
+        return -1;
+    for (i = 0; i < n; i += k) {
+        if ((k = pz_feed(c, d + i, n - i)) < 0 ||
+                (o = drain_all(c, z + nz, max - nz)) < 0)
+            goto fail;
+        nz += o;
+    }
+    if (pz_flush(c, PZ_FINISH) || (o = drain_all(c, z + nz, max - nz)) < 0)
+        goto fail;
+    pz_end(c);
+
+    return nz + o;
+
+fail:
+    pz_end(c);
+    return -1;
+}
+
+static uint32_t hc_hash(const uint8_t *p) {
+    uint32_t x;
+
+    memcpy(&x, p, 4);
+    return (x * 2654435761u) >> (32 - HC_BITS);
+}
+
+static int hc_len(const uint8_t *a, const uint8_t *b, int max) {
+    int l = 0;
+
+    while (l < max && a[l] == b[l])
+        l++;
+    return l;
+}
+
+// Longest match at pos, inserting pos in the chains
+//   With m, also lists the matches of increasing length (nearest first,
+//   as pz_lz_matches) and sets their count in *k
+static int hc_find(const uint8_t *d, int n, int pos, int depth, int *head,
+        int *prev, int *dist, pz_lz_match *m, int *k) {
+    uint32_t h = hc_hash(d + pos);
+    int      c, l, best = 3, j = 0;
+
+    for (c = head[h]; c >= 0 && depth--; c = prev[c]) {
+        l = hc_len(d + c, d + pos, n - pos);
+        if (l > best) {
+            best = l;
+            *dist = pos - c;
+            if (m) {
+                m[j].len = l;
+                m[j++].dist = pos - c;
+            }
+        }
+    }
+    if (m)
+        *k = j;
+    prev[pos] = head[h];
+    head[h] = pos;
+
+    return best;
+}
+
+struct hc {
+    int  depth;
+    int *head, *prev;
+};
+
+// Greedy parse as pz_lz_greedy, returns number of sequences
+static int hc_greedy(void *p, const uint8_t *d, int n, pz_lz_seq *seq,
+        uint8_t *lits) {
+    struct hc *hc = p;
+    int        pos = 0, start = 0, nseq = 0, l, dist, j;
+
+    for (j = 0; j < (1 << HC_BITS); j++)
+        hc->head[j] = -1;
+
+    while (pos + 4 <= n) {
+        l = hc_find(d, n, pos, hc->depth, hc->head, hc->prev, &dist, NULL,
+                NULL);
+        if (l < 4) {
+            pos++;
+            continue;
+        }
+        for (j = 1; j < l && pos + j + 4 <= n; j++) // Insert skipped
+            hc_find(d, n, pos + j, 0, hc->head, hc->prev, &dist, NULL, NULL);
+        seq[nseq].lit = pos - start;
+        seq[nseq].len = l;
+        seq[nseq++].dist = dist;
+        memcpy(lits, d + start, pos - start);
+        lits += pos - start;
+        start = pos += l;
+    }
+    if (start < n || nseq == 0) {
+        seq[nseq].lit = n - start;
+        seq[nseq].len = 0;
+        seq[nseq++].dist = 0;
+        memcpy(lits, d + start, n - start);
+    }
+
+    return nseq;
+}
+
+static int lz_greedy(void *lz, const uint8_t *d, int n, pz_lz_seq *seq,
+        uint8_t *lits) {
+    pz_lz_prepare(lz, d, n);
+    return pz_lz_greedy(lz, seq, lits);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t x) {
+    for (; x >= 0x80; x >>= 7)
+        *p++ = x | 0x80;
+    *p++ = x;
+    return p;
+}
+
+// Parse d by blocks into literals and varint sequences, then code both
+//   Each block is checked to decode. Prints the rates and the ratio.
+static void lz_stage(const char *name, int depth,
+        int (*parse)(void *, const uint8_t *, int, pz_lz_seq *, uint8_t *),
+        void *state, const uint8_t *d, int n) {
+    pz_lz_seq *seq = malloc((LZ_BLOCK / 4 + 1) * sizeof (pz_lz_seq));
+    uint8_t   *buf = malloc(n + LZ_BLOCK), *tok = malloc(4 * n + 1024);
+    uint8_t   *z = malloc(2 * n + 1024), *lits = buf, *t = tok;
+    int        b, bn, i, k, nseq = 0, nlits, nz, nt;
+    double     tp, tc;
+
+    tp = now();
+    for (b = 0; b < n; b += LZ_BLOCK) {
+        bn = n - b < LZ_BLOCK ? n - b : LZ_BLOCK;
+        k = parse(state, d + b, bn, seq, lits);
+        for (i = 0; i < k; i++) {
+            t = put_varint(t, seq[i].lit);
+            t = put_varint(t, seq[i].len);
+            t = put_varint(t, seq[i].dist);
+            lits += seq[i].lit;
+            nseq += seq[i].len > 0;
+        }
+    }
+    tp = now() - tp;
+    nlits = lits - buf;
+
+    tc = now();
+    nz = compress_all(buf, nlits, z, 2 * n + 1024);
+    nt = compress_all(tok, t - tok, z, 2 * n + 1024);
+    tc = now() - tc;
+
+    // Round trip of the parse, not timed
+    for (b = 0, lits = buf, t = z; b < n && nz >= 0 && nt >= 0;
+            b += LZ_BLOCK) {
+        bn = n - b < LZ_BLOCK ? n - b : LZ_BLOCK;
+        k = parse(state, d + b, bn, seq, lits);
+        if (pz_lz_decode(seq, k, lits, t) != bn || memcmp(t, d + b, bn)) {
+            nz = -1;
+            break;
+        }
+    }
+
+    if (nz < 0 || nt < 0)
+        printf("  %-6s depth %2d failed\n", name, depth);
+    else
+        printf("  %-6s depth %2d parse %7.1f MB/s  compress %7.1f MB/s"
+                "  %7d matches %8d literals  ratio %.3f\n", name, depth,
+                n / tp / 1e6, n / (tp + tc) / 1e6, nseq, nlits,
+                (double) (nz + nt) / n);
+
+    free(seq);
+    free(buf);
+    free(tok);
+    free(z);
+}
+
+static void bench_lz(const uint8_t *d, int n) {
+    static const int depths[] = { 4, 16, 64 };
+    pz_lz_match  m[64];
+    struct hc    hc;
+    int          b, bn, i, j, k, p, nz, dist;
+    int64_t      matches;
+    double       t;
+    pz_lz       *lz;
+    uint8_t     *z = malloc(2 * n + 1024);
+
+    hc.head = malloc((1 << HC_BITS) * sizeof (int));
+    hc.prev = malloc(LZ_BLOCK * sizeof (int));
+
+    printf("lz: %d bytes, blocks of %d\n", n, LZ_BLOCK);
+
+    t = now();
+    nz = compress_all(d, n, z, 2 * n + 1024);
+    t = now() - t;
+    printf("  pz alone         compress %7.1f MB/s  ratio %.3f\n",
+            n / t / 1e6, (double) nz / n);
+
+    for (i = 0; i < 3; i++) {
+
+        lz = pz_lz_new(LZ_BLOCK, depths[i]);
+
+        // The sort alone, then all matches as an optimal parser would ask
+        t = now();
+        for (b = 0; b < n; b += LZ_BLOCK)
+            pz_lz_prepare(lz, d + b, n - b < LZ_BLOCK ? n - b : LZ_BLOCK);
+        t = now() - t;
+        printf("  sorted depth %2d prepare %7.1f MB/s", depths[i],
+                n / t / 1e6);
+        t = now();
+        for (b = 0, matches = 0; b < n; b += LZ_BLOCK) {
+            bn = n - b < LZ_BLOCK ? n - b : LZ_BLOCK;
+            pz_lz_prepare(lz, d + b, bn);
+            for (p = 0; p < bn; p++)
+                matches += pz_lz_matches(lz, p, m, 64);
+        }
+        t = now() - t;
+        printf("  all %7.1f MB/s  %7.2f M matches/s\n", n / t / 1e6,
+                matches / t / 1e6);
+
+        // The same listing from the chains, every position inserted
+        t = now();
+        for (b = 0, matches = 0; b < n; b += LZ_BLOCK) {
+            bn = n - b < LZ_BLOCK ? n - b : LZ_BLOCK;
+            for (j = 0; j < (1 << HC_BITS); j++)
+                hc.head[j] = -1;
+            for (p = 0; p + 4 <= bn; p++) {
+                hc_find(d + b, bn, p, depths[i], hc.head, hc.prev, &dist,
+                        m, &k);
+                matches += k;
+            }
+        }
+        t = now() - t;
+        printf("  chain  depth %2d                       all %7.1f MB/s"
+                "  %7.2f M matches/s\n", depths[i], n / t / 1e6,
+                matches / t / 1e6);
+
+        lz_stage("sorted", depths[i], lz_greedy, lz, d, n);
+        hc.depth = depths[i];
+        lz_stage("chain", depths[i], hc_greedy, &hc, d, n);
+
+        pz_lz_free(lz);
+
+    }
+
+    free(z);
+    free(hc.head);
+    free(hc.prev);
+}
+
+//
+// Stream API: small message latency and bulk throughput
+//
+
+static void bench_stream(const uint8_t *d, int n) {
+    static const int   levels[] = { PZ_BEST, PZ_FAST4, PZ_FAST6, PZ_FAST8 };
+    static const char *names[] = { "bwt", "st4", "st6", "st8" };
+    pz_stream *c, *x;
+    uint8_t   *z, *out;
+    int        i, k, l, m, nz, nout, max = 2 * n + 1024;
+    double     t, tc, td;
+
+    z = malloc(max);
+    out = malloc(n + MSG);
+
+    // Each message is flushed as its own block, as a service would
+    m = n / MSG < MSGS ? n / MSG : MSGS;
+    c = pz_init(PZ_COMPRESS, 0);
+    x = pz_init(PZ_DECOMPRESS, 0);
+    for (i = 0, nz = 0, tc = td = 0; i < m; i++) {
+        t = now();
+        if (pz_feed(c, d + i * MSG, MSG) != MSG || pz_flush(c, PZ_FLUSH) ||
+                (k = drain_all(c, z, max)) < 0)
+            goto fail;
+        tc += now() - t;
+        nz += k;
+        t = now();
+        if (pz_feed(x, z, k) != k || drain_all(x, out, MSG) != MSG)
+            goto fail;
+        td += now() - t;
+    }
+    printf("stream: %d messages of %d bytes\n", m, MSG);
+    printf("  compress %7.1f us/msg  decompress %7.1f us/msg  ratio %.3f\n",
+            tc / m * 1e6, td / m * 1e6, (double) nz / (m * MSG));
+    pz_end(c);
+    pz_end(x);
+
+    // Whole input in one call at each level, blocks coded without a copy
+    printf("  bulk %d bytes\n", n);
+    for (l = 0; l < 4; l++) {
+        c = pz_init(PZ_COMPRESS, 0);
+        x = pz_init(PZ_DECOMPRESS, 0);
+        if (!c || !x || pz_level(c, levels[l]) != 0)
+            goto fail;
+        t = now();
+        for (i = 0, nz = 0; i < n; i += k) {
+            if ((k = pz_feed(c, d + i, n - i)) < 0 ||
+                    (nout = drain_all(c, z + nz, max - nz)) < 0)
+                goto fail;
+            nz += nout;
+        }
+        if (pz_flush(c, PZ_FINISH) ||
+                (nout = drain_all(c, z + nz, max - nz)) < 0)
+            goto fail;
+        nz += nout;
+        tc = now() - t;
+        t = now();
+        for (i = 0, m = 0; i < nz; i += k) {
+            if ((k = pz_feed(x, z + i, nz - i)) < 0 ||
+                    (nout = drain_all(x, out + m, n + MSG - m)) < 0)
+                goto fail;
+            m += nout;
+        }
+        if (pz_flush(x, PZ_FINISH) || m != n || memcmp(d, out, n))
+            goto fail;
+        td = now() - t;
+        printf("  %-5s compress %7.1f MB/s  decompress %7.1f MB/s"
+                "  ratio %.3f\n", names[l], n / tc / 1e6, n / td / 1e6,
+                (double) nz / n);
+        pz_end(c);
+        pz_end(x);
+    }
+
+    free(z);
+    free(out);
+    return;
+
+fail:
+    printf("stream: failed\n");
+    pz_end(c);
+    pz_end(x);
+    free(z);
+    free(out);
+}
+
+int main(int argc, char *argv[]) {
+    uint8_t *d;
+    int      n = 1 << 20;
+    FILE    *f;
+
+    if (argc > 1) {
+        if (!(f = fopen(argv[1], "rb"))) {
+            perror(argv[1]);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        n = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        d = malloc(n + 1);
+        n = fread(d, 1, n, f);
+        fclose(f);
+    } else {
+        d = malloc(n);
+        make_logs(d, n);
+    }
+
+    bench_lz(d, n);
+    bench_stream(d, n);
+
+    free(d);
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+//  PZ compressor, block codec
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements encoding and decoding of blocks
+//
+//  All work buffers are sized for the largest block when created, so
+//  blocks are coded without allocations. A block is stored when coding
+//  does not make it smaller.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block.h"
+
+struct block *block_new(int max, int encode) {
+    struct block *b;
+    int           len = ((max + 15) & ~15) / 4; // Vectors
+
+    if (!(b = calloc(1, sizeof (*b))))
+        return NULL;
+
+    if (!encode) // Byte flags, max bytes each
+        len = (len + 7) / 8;
+
+    b->max = max;
+    b->sa = malloc(max * sizeof (int32_t));
+    b->rank = malloc(max * sizeof (int32_t));
+    b->tmp = malloc(max * sizeof (int32_t));
+    b->v = _mm_malloc(2 * len * sizeof (v4si), 16);
+    b->aux = _mm_malloc(2 * len * sizeof (v4si), 16);
+    b->bwt = malloc(max);
+    if (encode) {
+        b->groups = malloc(2 * max * sizeof (int32_t));
+        b->sym = malloc(max * sizeof (uint16_t));
+    }
+    if (!b->sa || !b->rank || !b->tmp || !b->v || !b->aux || !b->bwt ||
+            (encode && (!b->groups || !b->sym))) {
+        block_free(b);
+        return NULL;
+    }
+
+    return b;
+}
+
+void block_free(struct block *b) {
+    if (!b)
+        return;
+    free(b->sa);
+    free(b->rank);
+    free(b->tmp);
+    free(b->groups);
+    _mm_free(b->v);
+    _mm_free(b->aux);
+    free(b->bwt);
+    free(b->sym);
+    free(b);
+}
+
+int block_encode(struct block *b, const uint8_t *in, int n, uint8_t *out,
+        int order) {
+    uint8_t *p = out + BLOCK_HEADER;
+    int      primary, h = order ? 5 : 4, k = -1; // Transform header
+
+    if (n > h + 4) {
+        if (order) {
+            p[0] = order;
+            primary = stk_forward(b, in, b->bwt, n, order);
+        } else
+            primary = bwt_forward(b, in, b->bwt, n);
+        put32(p + h - 4, primary);
+        k = huff_encode(b, b->bwt, n, p + h, n - h - 1);
+    }
+
+    if (k < 0) {
+        out[0] = BLOCK_STORED;
+        memcpy(p, in, n);
+        k = n;
+    } else {
+        out[0] = order ? BLOCK_STK : BLOCK_BWT;
+        k += h;
+    }
+    put32(out + 1, n);
+    put32(out + 5, k);
+
+    return BLOCK_HEADER + k;
+}
+
+int block_header(struct block *b, const uint8_t *in, int *raw, int *payload) {
+    uint32_t r = get32(in + 1), k = get32(in + 5);
+
+    if (in[0] > BLOCK_STK || r > (uint32_t) b->max || k > r)
+        return -1;
+    *raw = r;
+    *payload = k;
+
+    return 0;
+}
+
+int block_decode(struct block *b, const uint8_t *in, uint8_t *out) {
+    const uint8_t *p = in + BLOCK_HEADER;
+    int            n, k;
+
+    if (block_header(b, in, &n, &k) != 0)
+        return -1;
+
+    if (in[0] == BLOCK_STORED) {
+        if (k != n)
+            return -1;
+        memcpy(out, p, n);
+        return n;
+    }
+
+    if (in[0] == BLOCK_STK) {
+        if (k < 5 || huff_decode(b, p + 5, k - 5, b->bwt, n) != 0)
+            return -1;
+        return stk_inverse(b, b->bwt, out, n, p[0], get32(p + 1));
+    }
+
+    if (k < 4 || huff_decode(b, p + 4, k - 4, b->bwt, n) != 0)
+        return -1;
+
+    return bwt_inverse(b, b->bwt, out, n, get32(p));
+}
@@ -0,0 +1,102 @@
+//  PZ compressor, block codec
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  Block codec shared by the stream interface
+//
+//  A block is a 9 byte header (method, raw length, payload length, little
+//  endian) and its payload. Stored blocks hold the raw bytes, transformed
+//  blocks the primary index of the BWT and its MTF/Huffman coding. ST
+//  blocks (bounded context BWT) start with their context length.
+
+#ifndef PZ_BLOCK_H
+#define PZ_BLOCK_H
+
+#include <stdint.h>
+#include "sse2.h"
+
+#define BLOCK_HEADER    9
+#define BLOCK_STORED    0
+#define BLOCK_BWT       1
+#define BLOCK_STK       2
+
+// Bytes needed to encode a block of n bytes
+#define BLOCK_BOUND(n)  (BLOCK_HEADER + (n))
+
+// Little endian 32bit fields
+static inline void put32(uint8_t *p, uint32_t x) {
+    p[0] = x;
+    p[1] = x >> 8;
+    p[2] = x >> 16;
+    p[3] = x >> 24;
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// Work buffers for blocks up to max bytes, allocated once
+struct block {
+    int       max;
+    int32_t  *sa;       // Rotations in sorted order
+    int32_t  *rank;     // Sort group of each rotation
+    int32_t  *tmp;      // Sorted keys, decoder LF mapping
+    int32_t  *groups;   // Unsorted groups (start, length), 2 lists
+    v4si     *v, *aux;  // Pair sort buffers, decoder context flags
+    uint8_t  *bwt;      // Transformed block
+    uint16_t *sym;      // MTF and zero run symbols
+};
+
+// Work buffers for blocks up to max bytes, only the decoder's unless encode
+//   (the decoder has no groups nor symbols, and byte sized v and aux)
+struct block *block_new(int max, int encode);
+void block_free(struct block *b);
+
+// Encode n bytes of in (n <= max) into out, up to BLOCK_BOUND(n) bytes
+//   With order 0 a full BWT, else the ST of that order (4 to 8)
+//   Returns the number of bytes written
+int block_encode(struct block *b, const uint8_t *in, int n, uint8_t *out,
+        int order);
+
+// Read a block header, returns 0 or -1 if invalid for b
+int block_header(struct block *b, const uint8_t *in, int *raw, int *payload);
+
+// Decode a full block (header and payload) into out
+//   Returns the number of bytes written or -1 on corrupt data
+int block_decode(struct block *b, const uint8_t *in, uint8_t *out);
+
+// Sort m pairs of keys k and values x, by key then value
+void block_sort_pairs(struct block *b, int32_t *k, int32_t *x, int m);
+
+// Burrows-Wheeler transform of the rotations of in, returns primary index
+int bwt_forward(struct block *b, const uint8_t *in, uint8_t *out, int n);
+int bwt_inverse(struct block *b, const uint8_t *in, uint8_t *out, int n,
+        int primary);
+
+// ST of order k, rotations sorted by k bytes then position; as the BWT
+int stk_forward(struct block *b, const uint8_t *in, uint8_t *out, int n,
+        int k);
+int stk_inverse(struct block *b, const uint8_t *in, uint8_t *out, int n,
+        int k, int primary);
+
+// MTF, zero runs and canonical Huffman
+//   Encoding returns bytes written to out, or -1 if more than limit
+//   Decoding of n bytes returns 0, or -1 on corrupt data
+int huff_encode(struct block *b, const uint8_t *in, int n, uint8_t *out,
+        int limit);
+int huff_decode(struct block *b, const uint8_t *in, int avail, uint8_t *out,
+        int n);
+
+#endif
@@ -0,0 +1,165 @@
+//  PZ compressor, Burrows-Wheeler transform
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements the BWT of a block with the SIMD pair sort
+//
+//  Rotations (not suffixes, so no sentinel is needed) are sorted by prefix
+//  doubling. A first sort of (4 byte prefix, position) pairs groups them by
+//  prefix. Each round sorts only groups still tied, by the group of the
+//  rotation h positions ahead (rank, position) pairs, and then splits them.
+//  Ranks are updated after all groups are sorted, so a round sees only
+//  ranks of the previous one. Identical rotations never split, rounds stop
+//  at h >= n (any order of them gives the same transform).
+
+#include <stdint.h>
+#include <string.h>
+#include "sse2.h"
+#include "block.h"
+
+void block_sort_pairs(struct block *b, int32_t *k, int32_t *x, int m) {
+    int32_t *pk, *px, tk, tx;
+    v4si    *s;
+    int      len, i, j;
+
+    if (m <= 16) {
+        for (i = 1; i < m; i++) {
+            tk = k[i];
+            tx = x[i];
+            for (j = i; j > 0 && (k[j - 1] > tk ||
+                    (k[j - 1] == tk && x[j - 1] > tx)); j--) {
+                k[j] = k[j - 1];
+                x[j] = x[j - 1];
+            }
+            k[j] = tk;
+            x[j] = tx;
+        }
+        return;
+    }
+
+    len = ((m + 15) & ~15) / 4;
+    pk = (int32_t *) b->v;
+    px = (int32_t *) &b->v[len];
+    memcpy(pk, k, m * sizeof (int32_t));
+    memcpy(px, x, m * sizeof (int32_t));
+    for (i = m; i < len * 4; i++)
+        pk[i] = px[i] = INT32_MAX;
+
+    s = sort_kv_4si_sse2(b->v, b->aux, len);
+
+    memcpy(k, s, m * sizeof (int32_t));
+    memcpy(x, &s[len], m * sizeof (int32_t));
+}
+
+// Rank rotations of sorted keys k[s, s+m) by the start of their group
+//   Adds groups still tied to the list g, returns its new length
+static int split_groups(struct block *b, int s, int m, int32_t *g, int ng) {
+    const int32_t *k = b->tmp;
+    int            i, u;
+
+    for (i = u = s; i < s + m; i++) {
+        if (k[i] != k[u]) {
+            if (i - u > 1) {
+                g[ng++] = u;
+                g[ng++] = i - u;
+            }
+            u = i;
+        }
+        b->rank[b->sa[i]] = u;
+    }
+    if (i - u > 1) {
+        g[ng++] = u;
+        g[ng++] = i - u;
+    }
+
+    return ng;
+}
+
+int bwt_forward(struct block *b, const uint8_t *in, uint8_t *out, int n) {
+    int32_t *sa = b->sa, *k = b->tmp, *g = b->groups, *ng = b->groups + n;
+    int32_t *t;
+    int      i, j, h, len, nlen, primary = 0;
+
+    if (n < 2) {
+        memcpy(out, in, n);
+        return 0;
+    }
+
+    // Sort by 4 byte prefix, unsigned
+    for (i = 0; i < n; i++) {
+        k[i] = (int32_t) (((uint32_t) in[i] << 24 |
+                (uint32_t) in[(i + 1) % n] << 16 |
+                (uint32_t) in[(i + 2) % n] << 8 |
+                (uint32_t) in[(i + 3) % n]) ^ 0x80000000u);
+        sa[i] = i;
+    }
+    block_sort_pairs(b, k, sa, n);
+    len = split_groups(b, 0, n, g, 0);
+
+    for (h = 4; len > 0 && h < n; h *= 2) {
+
+        // Sort tied groups by the rank h ahead
+        for (i = 0; i < len; i += 2) {
+            for (j = g[i]; j < g[i] + g[i + 1]; j++)
+                k[j] = b->rank[(sa[j] + h) % n];
+            block_sort_pairs(b, &k[g[i]], &sa[g[i]], g[i + 1]);
+        }
+
+        for (i = 0, nlen = 0; i < len; i += 2)
+            nlen = split_groups(b, g[i], g[i + 1], ng, nlen);
+
+        t = g; // Swap lists
+        g = ng;
+        ng = t;
+        len = nlen;
+
+    }
+
+    for (i = 0; i < n; i++) {
+        if (sa[i] == 0)
+            primary = i;
+        out[i] = in[(sa[i] + n - 1) % n];
+    }
+
+    return primary;
+}
+
+int bwt_inverse(struct block *b, const uint8_t *in, uint8_t *out, int n,
+        int primary) {
+    int32_t *lf = b->tmp;
+    int      count[256] = { 0 }, i, j, c;
+
+    if (primary < 0 || primary >= (n > 0 ? n : 1))
+        return -1;
+
+    for (i = 0; i < n; i++)
+        count[in[i]]++;
+    for (i = 0, j = 0; i < 256; i++) { // First row of each byte
+        c = count[i];
+        count[i] = j;
+        j += c;
+    }
+
+    // Row of the rotation one position back
+    for (i = 0; i < n; i++)
+        lf[i] = count[in[i]]++;
+
+    for (i = n - 1, j = primary; i >= 0; i--) {
+        out[i] = in[j];
+        j = lf[j];
+    }
+
+    return n;
+}
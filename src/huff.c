@@ -0,0 +1,260 @@
+//  PZ compressor, entropy coding of transformed blocks
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements move to front, zero runs and Huffman coding
+//
+//  Bytes are move to front coded. Runs of zeros become bijective base 2
+//  numbers of RUNA/RUNB digits (as bzip2), other ranks r become r + 1.
+//  Symbols are coded with a canonical Huffman code limited to 12 bits,
+//  so a single table lookup decodes each one (MSB first).
+//
+//  Layout: symbol count (4 bytes), code lengths (4 bits each), codes.
+
+#include <stdint.h>
+#include <string.h>
+#include "block.h"
+
+#define RUNA        0
+#define RUNB        1
+#define SYMBOLS     257     // RUNA, RUNB, ranks 1 to 255
+#define MAX_BITS    12
+#define LENGTHS     ((SYMBOLS + 1) / 2)
+
+// Move to front and zero runs of n bytes into sym, returns symbols
+static int mtf_encode(const uint8_t *in, int n, uint16_t *sym) {
+    uint8_t list[256], c, t;
+    int     i, j, k = 0, run = 0;
+
+    for (i = 0; i < 256; i++)
+        list[i] = i;
+
+    for (i = 0; i <= n; i++) {
+
+        if (i < n && in[i] == list[0]) {
+            run++;
+            continue;
+        }
+
+        // Flush zeros, bijective base 2
+        for (run--; run >= 0; run = (run - 2) / 2) {
+            sym[k++] = run & 1 ? RUNB : RUNA;
+            if (run < 2)
+                break;
+        }
+        run = 0;
+
+        if (i == n)
+            break;
+
+        c = in[i];
+        for (j = 1, t = list[0]; list[j] != c; j++) { // Shift until c
+            uint8_t u = list[j];
+            list[j] = t;
+            t = u;
+        }
+        list[j] = t;
+        list[0] = c;
+        sym[k++] = j + 1;
+
+    }
+
+    return k;
+}
+
+// Code lengths of the symbols with count, limited to MAX_BITS
+//   Two queue Huffman on leaves sorted by count; if too deep, counts are
+//   flattened and it is built again
+static void huff_lengths(const uint32_t *count, uint8_t *len) {
+    uint32_t w[2 * SYMBOLS], c[SYMBOLS];
+    int      leaf[SYMBOLS], parent[2 * SYMBOLS], depth[2 * SYMBOLS];
+    int      i, j, n, l, q, k, a, deep;
+
+    for (i = 0; i < SYMBOLS; i++)
+        c[i] = count[i];
+
+    do {
+
+        // Used symbols by increasing count (insertion sort, few)
+        for (i = 0, n = 0; i < SYMBOLS; i++) {
+            len[i] = 0;
+            if (!c[i])
+                continue;
+            for (j = n++; j > 0 && c[leaf[j - 1]] > c[i]; j--)
+                leaf[j] = leaf[j - 1];
+            leaf[j] = i;
+        }
+        if (n == 1)
+            len[leaf[0]] = 1;
+        if (n < 2)
+            return;
+
+        for (i = 0; i < n; i++)
+            w[i] = c[leaf[i]];
+
+        // Internal nodes come out in increasing weight
+        for (k = n, l = 0, q = n; k < 2 * n - 1; k++) {
+            for (j = 0, w[k] = 0; j < 2; j++) {
+                a = l < n && (q == k || w[l] <= w[q]) ? l++ : q++;
+                parent[a] = k;
+                w[k] += w[a];
+            }
+        }
+
+        depth[2 * n - 2] = 0;
+        for (k = 2 * n - 3, deep = 0; k >= 0; k--) {
+            depth[k] = depth[parent[k]] + 1;
+            if (k < n && depth[k] > MAX_BITS)
+                deep = 1;
+        }
+
+        for (i = 0; i < SYMBOLS; i++) // Flatten and retry
+            if (c[i])
+                c[i] = (c[i] >> 1) | 1;
+
+    } while (deep);
+
+    for (i = 0; i < n; i++)
+        len[leaf[i]] = depth[i];
+}
+
+// Canonical codes from lengths, returns -1 if over subscribed
+static int huff_codes(const uint8_t *len, uint16_t *code) {
+    int count[MAX_BITS + 1] = { 0 }, next[MAX_BITS + 1], i, c = 0;
+
+    for (i = 0; i < SYMBOLS; i++)
+        count[len[i]]++;
+    count[0] = 0;
+    for (i = 1; i <= MAX_BITS; i++) {
+        next[i] = c = (c + count[i - 1]) << 1;
+        if (c + count[i] > (1 << i))
+            return -1;
+    }
+    for (i = 0; i < SYMBOLS; i++)
+        if (len[i])
+            code[i] = next[len[i]]++;
+
+    return 0;
+}
+
+int huff_encode(struct block *b, const uint8_t *in, int n, uint8_t *out,
+        int limit) {
+    uint32_t count[SYMBOLS] = { 0 }, acc = 0;
+    uint16_t code[SYMBOLS];
+    uint8_t  len[SYMBOLS + 1], *p;
+    int64_t  bits = 0;
+    int      k, i, nbits = 0;
+
+    k = mtf_encode(in, n, b->sym);
+    for (i = 0; i < k; i++)
+        count[b->sym[i]]++;
+    huff_lengths(count, len);
+    huff_codes(len, code);
+
+    for (i = 0; i < SYMBOLS; i++)
+        bits += (int64_t) count[i] * len[i];
+    if (4 + LENGTHS + (bits + 7) / 8 > limit)
+        return -1;
+
+    put32(out, k);
+    len[SYMBOLS] = 0;
+    for (i = 0; i < LENGTHS; i++)
+        out[4 + i] = len[2 * i] | len[2 * i + 1] << 4;
+
+    p = out + 4 + LENGTHS;
+    for (i = 0; i < k; i++) {
+        acc = acc << len[b->sym[i]] | code[b->sym[i]];
+        nbits += len[b->sym[i]];
+        while (nbits >= 8)
+            *p++ = acc >> (nbits -= 8);
+    }
+    if (nbits)
+        *p++ = acc << (8 - nbits);
+
+    return p - out;
+}
+
+int huff_decode(struct block *b, const uint8_t *in, int avail, uint8_t *out,
+        int n) {
+    const uint8_t *p = in + 4 + LENGTHS, *end = in + avail;
+    uint16_t       code[SYMBOLS], table[1 << MAX_BITS];
+    uint64_t       acc = 0;
+    uint8_t        len[SYMBOLS], list[256], c;
+    int            k, i, j, s = 0, nbits = 0, o = 0, run = 0, digit = 1;
+
+    if (avail < 4 + LENGTHS)
+        return -1;
+    k = get32(in);
+    for (i = 0; i < SYMBOLS; i++) {
+        len[i] = in[4 + i / 2] >> (i & 1 ? 4 : 0) & 15;
+        if (len[i] > MAX_BITS)
+            return -1;
+    }
+    if (huff_codes(len, code) != 0)
+        return -1;
+
+    // Lookup of the next MAX_BITS bits: symbol << 4 | length, 0 unused
+    memset(table, 0, sizeof (table));
+    for (i = 0; i < SYMBOLS; i++)
+        if (len[i])
+            for (j = code[i] << (MAX_BITS - len[i]);
+                    j < (code[i] + 1) << (MAX_BITS - len[i]); j++)
+                table[j] = i << 4 | len[i];
+
+    for (i = 0; i < 256; i++)
+        list[i] = i;
+
+    for (; k >= 0; k--) {
+
+        if (k > 0) {
+            while (nbits <= 56) { // Refill, zeros past the end
+                acc |= (uint64_t) (p < end ? *p++ : 0) << (56 - nbits);
+                nbits += 8;
+            }
+            j = table[acc >> (64 - MAX_BITS)];
+            if (!j)
+                return -1;
+            acc <<= j & 15;
+            nbits -= j & 15;
+            s = j >> 4;
+            if (s <= RUNB) {
+                run += digit << s;
+                digit <<= 1;
+                if (run > n - o)
+                    return -1;
+                continue;
+            }
+        }
+
+        if (run) { // Flush zeros
+            memset(out + o, list[0], run);
+            o += run;
+            run = 0;
+            digit = 1;
+        }
+        if (k == 0)
+            break;
+
+        if (o == n)
+            return -1;
+        c = list[s - 1];
+        memmove(list + 1, list, s - 1);
+        list[0] = c;
+        out[o++] = c;
+
+    }
+
+    return o == n ? 0 : -1;
+}
@@ -0,0 +1,386 @@
+//  PZ compressor, LZ77 match finder
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements an LZ77 match finder built on the SIMD sort
+//
+//  Positions with 4 bytes ahead are sorted by their first 8 bytes, then by
+//  position. Pairs of the full 32bit hash of the first 4 bytes and the
+//  position are spread by the top bits of the hash into buckets that fit
+//  in cache, as in the ST transform, and each bucket is pair sorted. The
+//  hash is a bijection of the prefix, so positions of equal hash share 4
+//  bytes; each such group is then pair sorted by the next 4 (packed in
+//  order) and position. No per-position insertion.
+//
+//  Between sorted neighbours the common prefix (LCP, up to 8 bytes) is kept.
+//  A position shares with any other as much as the shortest LCP in between,
+//  so the lookup walks out from it taking next the side with the longer
+//  prefix, and knows the match length without reading the data. Only the
+//  run of positions sharing all 8 bytes (in position order, nearest first)
+//  is verified past them. For optimal parsing all matches of increasing
+//  length are reported per position (nearest first); greedy parsing keeps
+//  the longest, stopping the sides that can't beat it.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sse2.h"
+#include "pz.h"
+
+#define MIN_MATCH 4
+#define MAX_LCP   8     // Sorted prefix
+
+#define BUCKET_BITS     16
+#define BUCKETS         (1 << BUCKET_BITS)
+#define BUCKET_SHIFT    (32 - BUCKET_BITS)
+
+struct pz_lz {
+    const uint8_t *data;
+    int            n;
+    int            k;       // Positions sorted
+    int            max;     // Block size
+    int            depth;   // Neighbours visited per position
+    v4si          *v, *aux; // Pair sort buffers
+    int32_t       *sa;      // Positions in sorted order
+    int32_t       *rank;    // Sorted index of each position, -1 none
+    int32_t       *end;     // First index past the run sharing 8 bytes
+    uint8_t       *lcp;     // Common prefix with the previous, up to 8
+    int32_t       *count;   // Bucket starts
+    pz_lz_match   *cand;    // Candidates of a position
+};
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t x;
+    memcpy(&x, p, 4);
+    return x;
+}
+
+// Bytes 4 to 7 at i (zero past n), ordered as signed keys
+static int32_t pack(const uint8_t *d, int i, int n) {
+    uint32_t x = 0;
+    int      j;
+
+    for (j = 4; j < 8; j++)
+        x = x << 8 | (i + j < n ? d[i + j] : 0);
+
+    return (int32_t) (x ^ 0x80000000u);
+}
+
+// Length of common prefix of a and b, up to max
+static int match_len(const uint8_t *a, const uint8_t *b, int max) {
+    uint64_t x, y;
+    int      l = 0;
+
+    while (l + 8 <= max) {
+        memcpy(&x, a + l, 8);
+        memcpy(&y, b + l, 8);
+        if (x != y)
+            return l + __builtin_ctzll(x ^ y) / 8; // Little endian
+        l += 8;
+    }
+    while (l < max && a[l] == b[l])
+        l++;
+
+    return l;
+}
+
+pz_lz *pz_lz_new(int max, int depth) {
+    pz_lz *lz;
+    int    len;
+
+    if (max <= 0 || max > PZ_LZ_MAX_BLOCK)
+        return NULL;
+
+    lz = calloc(1, sizeof (pz_lz));
+    if (!lz)
+        return NULL;
+
+    lz->max = max;
+    lz->depth = depth > 0 ? depth : 1;
+    len = ((max + 15) & ~15) / 4;
+    lz->v = _mm_malloc(2 * len * sizeof (v4si), 16);
+    lz->aux = _mm_malloc(2 * len * sizeof (v4si), 16);
+    lz->sa = malloc(max * sizeof (int32_t));
+    lz->rank = malloc(max * sizeof (int32_t));
+    lz->end = malloc(max * sizeof (int32_t));
+    lz->lcp = malloc(max);
+    lz->count = malloc((BUCKETS + 1) * sizeof (int32_t));
+    lz->cand = malloc(lz->depth * sizeof (pz_lz_match));
+    if (!lz->v || !lz->aux || !lz->sa || !lz->rank || !lz->end || !lz->lcp ||
+            !lz->count || !lz->cand) {
+        pz_lz_free(lz);
+        return NULL;
+    }
+
+    return lz;
+}
+
+void pz_lz_free(pz_lz *lz) {
+    if (!lz)
+        return;
+    _mm_free(lz->v);
+    _mm_free(lz->aux);
+    free(lz->sa);
+    free(lz->rank);
+    free(lz->end);
+    free(lz->lcp);
+    free(lz->count);
+    free(lz->cand);
+    free(lz);
+}
+
+// Sort m pairs of keys k and values x, by key then value
+//   Pairs come in position order, often of a single key: those are left
+static void sort_pairs(pz_lz *lz, int32_t *k, int32_t *x, int m) {
+    int32_t *pk, *px, tk, tx;
+    v4si    *s;
+    int      len, i, j;
+
+    for (i = 1; i < m && k[i - 1] <= k[i]; i++)
+        if (k[i - 1] == k[i] && x[i - 1] > x[i])
+            break;
+    if (i >= m)
+        return;
+
+    if (m <= 16) {
+        for (i = 1; i < m; i++) {
+            tk = k[i];
+            tx = x[i];
+            for (j = i; j > 0 && (k[j - 1] > tk ||
+                    (k[j - 1] == tk && x[j - 1] > tx)); j--) {
+                k[j] = k[j - 1];
+                x[j] = x[j - 1];
+            }
+            k[j] = tk;
+            x[j] = tx;
+        }
+        return;
+    }
+
+    len = ((m + 15) & ~15) / 4;
+    pk = (int32_t *) lz->v;
+    px = (int32_t *) &lz->v[len];
+    memcpy(pk, k, m * sizeof (int32_t));
+    memcpy(px, x, m * sizeof (int32_t));
+    for (i = m; i < len * 4; i++)
+        pk[i] = px[i] = INT32_MAX;
+
+    s = sort_kv_4si_sse2(lz->v, lz->aux, len);
+
+    memcpy(k, s, m * sizeof (int32_t));
+    memcpy(x, &s[len], m * sizeof (int32_t));
+}
+
+static int32_t hash(const uint8_t *p) {
+    return (int32_t) (read32(p) * 2654435761u);
+}
+
+int pz_lz_prepare(pz_lz *lz, const uint8_t *data, int n) {
+    int32_t *sa = lz->sa, *key = lz->rank, *h = lz->end;
+    uint8_t *lcp = lz->lcp;
+    uint32_t x;
+    int32_t *count = lz->count;
+    int      i, j, g, k, a, l, r;
+
+    if (n < 0 || n > lz->max)
+        return -1;
+
+    lz->data = data;
+    lz->n = n;
+    lz->k = k = n - MIN_MATCH + 1 > 0 ? n - MIN_MATCH + 1 : 0;
+
+    // Spread by the top bits of the hash, in position order
+    memset(count, 0, (BUCKETS + 1) * sizeof (int32_t));
+    for (i = 0; i < k; i++) {
+        h[i] = hash(data + i);
+        count[((uint32_t) h[i] >> BUCKET_SHIFT) + 1]++;
+    }
+    for (i = 1; i <= BUCKETS; i++)
+        count[i] += count[i - 1];
+    for (i = 0; i < k; i++) {
+        j = count[(uint32_t) h[i] >> BUCKET_SHIFT]++;
+        key[j] = h[i];
+        sa[j] = i;
+    }
+
+    // Each bucket by hash, then each hash by bytes 4 to 7 (both by position)
+    //   The keys of a group give its common prefixes, other groups share
+    //   less than 4 bytes
+    for (i = 0, j = 0; i < BUCKETS; j = count[i++]) {
+        sort_pairs(lz, &key[j], &sa[j], count[i] - j);
+        for (; j < count[i]; j = g) {
+            for (g = j + 1; g < count[i] && key[g] == key[j]; g++)
+                ;
+            lcp[j] = 0;
+            if (g - j < 2)
+                continue;
+            for (a = j; a < g; a++)
+                key[a] = pack(data, sa[a], n);
+            sort_pairs(lz, &key[j], &sa[j], g - j);
+            for (a = j + 1; a < g; a++) {
+                x = key[a - 1] ^ key[a];
+                l = x ? MIN_MATCH + __builtin_clz(x) / 8 : MAX_LCP;
+                r = n - (sa[a - 1] > sa[a] ? sa[a - 1] : sa[a]); // Padding
+                lcp[a] = l < r ? l : r;
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        lz->rank[i] = -1;
+    for (i = 0; i < k; i++)
+        lz->rank[sa[i]] = i;
+
+    // Runs sharing all sorted bytes
+    for (i = k - 1; i >= 0; i--)
+        lz->end[i] = i + 1 < k && lcp[i + 1] == MAX_LCP ?
+                lz->end[i + 1] : i + 1;
+
+    return 0;
+}
+
+// Candidates at pos in m, walking out from it in sorted order
+//   With longest only the best (longest, then nearest) is kept in m[0]
+//   Returns the number of candidates
+static int candidates(pz_lz *lz, int pos, pz_lz_match *m, int longest) {
+    const uint8_t *d = lz->data;
+    const uint8_t *lcp = lz->lcp;
+    int            r = lz->rank[pos], rem = lz->n - pos;
+    int            lo, hi, ll, hl, c, l, k = 0, best = MIN_MATCH - 1;
+    int            depth = lz->depth;
+
+    if (r < 0)
+        return 0;
+
+    // Past the run of pos the right side has no position before it
+    lo = r - 1;
+    hi = lz->end[r];
+    ll = lo >= 0 ? lcp[r] : 0;
+    hl = hi < lz->k ? lcp[hi] : 0;
+
+    while (depth--) {
+
+        if (longest) { // Shorter sides can't improve
+            if (ll < MAX_LCP && ll <= best)
+                ll = 0;
+            if (hl <= best)
+                hl = 0;
+        }
+
+        if (ll >= hl && ll >= MIN_MATCH) {
+            c = lz->sa[lo];
+            l = ll;
+            lo--;
+            ll = lo < 0 ? 0 : lcp[lo + 1] < ll ? lcp[lo + 1] : ll;
+        } else if (hl >= MIN_MATCH) {
+            c = lz->sa[hi];
+            l = hl;
+            hi++;
+            hl = hi >= lz->k ? 0 : lcp[hi] < hl ? lcp[hi] : hl;
+        } else
+            break;
+
+        if (c > pos)
+            continue;
+        if (l == MAX_LCP) // In the run of pos, check the rest
+            l = MAX_LCP + match_len(d + c + MAX_LCP, d + pos + MAX_LCP,
+                    rem - MAX_LCP);
+
+        if (!longest) {
+            m[k].len = l;
+            m[k++].dist = pos - c;
+        } else if (l > best || (l == best && pos - c < m[0].dist)) {
+            m[0].len = best = l;
+            m[0].dist = pos - c;
+            k = 1;
+            if (l == rem)
+                break;
+        }
+
+    }
+
+    return k;
+}
+
+int pz_lz_matches(pz_lz *lz, int pos, pz_lz_match *m, int max) {
+    pz_lz_match *c = lz->cand, t;
+    int          n, i, j, k = 0;
+
+    if (pos < 0 || pos >= lz->n)
+        return 0;
+
+    n = candidates(lz, pos, c, 0);
+
+    // Nearest first, then only the ones longer than all nearer
+    for (i = 1; i < n; i++) {
+        t = c[i];
+        for (j = i; j > 0 && c[j - 1].dist > t.dist; j--)
+            c[j] = c[j - 1];
+        c[j] = t;
+    }
+    for (i = 0; i < n && k < max; i++)
+        if (k == 0 || c[i].len > m[k - 1].len)
+            m[k++] = c[i];
+
+    return k;
+}
+
+int pz_lz_greedy(pz_lz *lz, pz_lz_seq *seq, uint8_t *lits) {
+    const uint8_t *d = lz->data;
+    pz_lz_match    m;
+    int            pos = 0, start = 0, nseq = 0;
+
+    while (pos + MIN_MATCH <= lz->n) {
+
+        if (candidates(lz, pos, &m, 1) == 0) {
+            pos++;
+            continue;
+        }
+
+        seq[nseq].lit = pos - start;
+        seq[nseq].len = m.len;
+        seq[nseq++].dist = m.dist;
+        memcpy(lits, d + start, pos - start);
+        lits += pos - start;
+        start = pos += m.len;
+
+    }
+
+    // Trailing literals
+    if (start < lz->n || nseq == 0) {
+        seq[nseq].lit = lz->n - start;
+        seq[nseq].len = 0;
+        seq[nseq++].dist = 0;
+        memcpy(lits, d + start, lz->n - start);
+    }
+
+    return nseq;
+}
+
+int pz_lz_decode(const pz_lz_seq *seq, int nseq, const uint8_t *lits,
+        uint8_t *out) {
+    uint8_t *o = out;
+    int      i, j;
+
+    for (i = 0; i < nseq; i++) {
+        memcpy(o, lits, seq[i].lit);
+        lits += seq[i].lit;
+        o += seq[i].lit;
+        for (j = 0; j < seq[i].len; j++, o++) // May overlap
+            *o = o[-seq[i].dist];
+    }
+
+    return o - out;
+}
@@ -0,0 +1,205 @@
+//  PZ compressor, K-way merge
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements merging of k sorted sequences of any length
+//
+//  Sequences are merged in a balanced tree of SIMD 2-way merges
+//  (merge_i32_sse2), one pass over the data per level, ping-ponging
+//  between the output and a scratch buffer.
+//
+//  The parallel mode splits the output in equal parts. The co-rank of a
+//  split position p is found by binary search on the key value: the
+//  smallest key v with at least p keys <= v. Each input contributes its
+//  keys < v, and keys equal to v are taken in input order up to p.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sse2.h"
+#include "pz.h"
+
+// Merge tree of k sequences into dst, using scratch of the same size
+static void merge_tree(int32_t *dst, int32_t *scratch,
+        const int32_t *const in[], const int len[], int k) {
+    int i, h, nl = 0, nr = 0;
+
+    if (k == 1) {
+        memcpy(dst, in[0], len[0] * sizeof (int32_t));
+        return;
+    }
+    if (k == 2) {
+        merge_i32_sse2(dst, in[0], len[0], in[1], len[1], 0);
+        return;
+    }
+
+    h = k / 2;
+    for (i = 0; i < h; i++)
+        nl += len[i];
+    for (; i < k; i++)
+        nr += len[i];
+
+    // Each half merges into scratch using dst as its own scratch
+    merge_tree(scratch, dst, in, len, h);
+    merge_tree(scratch + nl, dst + nl, in + h, len + h, k - h);
+    merge_i32_sse2(dst, scratch, nl, scratch + nl, nr, 0);
+}
+
+// Number of elements of sorted s < x (or <= x if upper)
+static int rank_i32(const int32_t *s, int n, int32_t x, int upper) {
+    int lo = 0, hi = n, m;
+
+    while (lo < hi) {
+        m = lo + (hi - lo) / 2;
+        if (s[m] < x || (upper && s[m] == x))
+            lo = m + 1;
+        else
+            hi = m;
+    }
+
+    return lo;
+}
+
+// Split positions of each input for the first p elements of the output
+static void corank_i32(const int32_t *const in[], const int len[], int k,
+        int p, int *split) {
+    int64_t lo = INT32_MIN, hi = INT32_MAX, m;
+    int     i, c;
+
+    // Smallest v with at least p elements <= v
+    while (lo < hi) {
+        m = lo + (hi - lo) / 2;
+        for (i = 0, c = 0; i < k && c < p; i++)
+            c += rank_i32(in[i], len[i], m, 1);
+        if (c >= p)
+            hi = m;
+        else
+            lo = m + 1;
+    }
+
+    for (i = 0, c = 0; i < k; i++)
+        c += (split[i] = rank_i32(in[i], len[i], lo, 0));
+
+    // Elements equal to v in input order
+    for (i = 0; i < k && c < p; i++) {
+        m = rank_i32(in[i], len[i], lo, 1) - split[i];
+        if (m > p - c)
+            m = p - c;
+        split[i] += m;
+        c += m;
+    }
+}
+
+struct merge_part {
+    const int32_t **in;     // Slices of inputs
+    int            *len;
+    int             k;
+    int32_t        *dst;
+    int32_t        *scratch;
+};
+
+static void *merge_part_run(void *arg) {
+    struct merge_part *mp = arg;
+    int i, j;
+
+    // Skip empty slices
+    for (i = j = 0; i < mp->k; i++)
+        if (mp->len[i]) {
+            mp->in[j] = mp->in[i];
+            mp->len[j++] = mp->len[i];
+        }
+    if (j)
+        merge_tree(mp->dst, mp->scratch, mp->in, mp->len, j);
+
+    return NULL;
+}
+
+int pz_merge_k_i32_mt(const int32_t *const inputs[], const int lengths[],
+        int k, int32_t *out, int threads) {
+    struct merge_part *mp = NULL;
+    pthread_t         *tid = NULL;
+    char              *joined = NULL;
+    int32_t           *scratch = NULL;
+    int               *split = NULL, *len = NULL;
+    const int32_t    **in = NULL;
+    int                n = 0, i, t, ret = -1;
+
+    for (i = 0; i < k; i++)
+        n += lengths[i];
+    if (n == 0)
+        return 0;
+    if (threads < 1)
+        threads = 1;
+    if (threads > n)
+        threads = n;
+
+    scratch = malloc(n * sizeof (int32_t));
+    split = malloc((threads + 1) * k * sizeof (int));
+    len = malloc(threads * k * sizeof (int));
+    in = malloc(threads * k * sizeof (*in));
+    mp = malloc(threads * sizeof (*mp));
+    tid = malloc(threads * sizeof (*tid));
+    joined = malloc(threads);
+    if (!scratch || !split || !len || !in || !mp || !tid || !joined)
+        goto out;
+
+    for (t = 0; t <= threads; t++)
+        corank_i32(inputs, lengths, k, (int) ((int64_t) n * t / threads),
+                &split[t * k]);
+
+    for (t = 0; t < threads; t++) {
+        int off = (int) ((int64_t) n * t / threads);
+
+        for (i = 0; i < k; i++) {
+            in[t * k + i] = inputs[i] + split[t * k + i];
+            len[t * k + i] = split[(t + 1) * k + i] - split[t * k + i];
+        }
+        mp[t].in = &in[t * k];
+        mp[t].len = &len[t * k];
+        mp[t].k = k;
+        mp[t].dst = out + off;
+        mp[t].scratch = scratch + off;
+    }
+
+    // First part on the calling thread
+    for (t = 1; t < threads; t++) {
+        joined[t] = pthread_create(&tid[t], NULL, merge_part_run, &mp[t]) == 0;
+        if (!joined[t])
+            merge_part_run(&mp[t]);
+    }
+    merge_part_run(&mp[0]);
+    for (t = 1; t < threads; t++)
+        if (joined[t])
+            pthread_join(tid[t], NULL);
+
+    ret = n;
+
+out:
+    free(scratch);
+    free(split);
+    free(len);
+    free(in);
+    free(mp);
+    free(tid);
+    free(joined);
+
+    return ret;
+}
+
+int pz_merge_k_i32(const int32_t *const inputs[], const int lengths[],
+        int k, int32_t *out) {
+    return pz_merge_k_i32_mt(inputs, lengths, k, out, 1);
+}
@@ -0,0 +1,110 @@
+//  PZ compressor, generated SSE2 sorting networks
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  The fixed size networks of the sort, instantiated from network.hpp
+//
+//  These replace the hand written register sort and 4 and 8 vector
+//  merges of sse2.c, behind the same names (declared in sse2.h). The
+//  2 vector merge stays in sse2.c, inlined in the loops of the run and
+//  set merges there.
+
+#if defined(__SSE2__) && !defined(PZ_PORTABLE) // Else sse2.h has no networks
+
+#include <stdint.h>
+#include <emmintrin.h>
+#include "network.hpp"
+
+typedef pz::simd<int32_t, 4> si4;
+typedef pz::simd<float, 4>   sf4;
+
+extern "C" {
+
+// Sort registers 4 at a time (each vector sorted)
+//   len must be multiple of 4 (4x4)
+void register_seq_sort_4si_sse2(__m128i *v, int len) {
+    int i;
+
+    for (i = 0; i < len; i += 4) {
+        pz::columns<si4, 4>::sort(&v[i]);
+        si4::transpose(&v[i]);
+    }
+}
+
+// Sort blocks of 8 vectors (32 elements) in place
+//   len must be multiple of 4 (4x4), an odd last block of 4 is sorted alone
+void sort_blocks_4si_sse2(__m128i *v, int len) {
+    int i;
+
+    for (i = 0; i + 8 <= len; i += 8)
+        pz::network<si4, 8>::sort((int32_t *) &v[i]);
+    if (i < len)
+        pz::network<si4, 4>::sort((int32_t *) &v[i]);
+}
+
+#ifdef TEST
+
+// Generated network test interfaces
+void pz_column_sort_4si_sse2(__m128i *v) {
+    pz::columns<si4, 4>::sort(v);
+}
+void pz_register_sort_4si_sse2(__m128i *v) {
+    pz::columns<si4, 4>::sort(v);
+    si4::transpose(v);
+}
+void pz_bitonic_sort_2x_4si_sse2(__m128i *a, __m128i *b, __m128i *c,
+        __m128i *d) {
+    __m128i r[2] = { *a, *b }, s[2] = { *c, *d };
+
+    pz::network<si4, 2>::merge(r);
+    pz::network<si4, 2>::merge(s);
+    *a = r[0];
+    *b = r[1];
+    *c = s[0];
+    *d = s[1];
+}
+void pz_merge_2l_2x4si_sse2(__m128i *s1, __m128i *s2) {
+    __m128i r[4] = { s1[0], s1[1], s2[0], s2[1] };
+
+    pz::network<si4, 4>::merge(r);
+    s1[0] = r[0];
+    s1[1] = r[1];
+    s2[0] = r[2];
+    s2[1] = r[3];
+}
+void pz_merge_parallel_2x2l_2x8si_sse2(__m128i *v) {
+    pz::network<si4, 4>::merge(&v[0]);
+    pz::network<si4, 4>::merge(&v[4]);
+}
+void pz_bitonic_merge_2x16si_sse2(__m128i *v) {
+    pz::network<si4, 8>::merge(v);
+}
+void pz_register_seq_sort_4si_sse2(__m128i *v, int len) {
+    register_seq_sort_4si_sse2(v, len);
+}
+void pz_sort_blocks_4sf_sse2(__m128 *v, int len) {
+    int i;
+
+    for (i = 0; i + 8 <= len; i += 8)
+        pz::network<sf4, 8>::sort((float *) &v[i]);
+    if (i < len)
+        pz::network<sf4, 4>::sort((float *) &v[i]);
+}
+
+#endif
+
+}
+
+#endif
@@ -0,0 +1,309 @@
+//  PZ compressor, sorting network generator
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  Header only generator of bitonic sort and merge networks (C++17)
+//
+//  network<S, R> works on R registers of the vector type described by
+//  the traits S (element type and lane count L), holding R*L elements in
+//  natural order (register j lane i is element j*L + i). Everything is
+//  unrolled at compile time into the intrinsics of S.
+//
+//  A bitonic merge compares registers at distances R/2..1 (minmax, no
+//  shuffles), then distances L/2..1 inside registers. For those, a pair
+//  of registers is split so lanes with bit D clear go to one register and
+//  their partners to the other, lanes of the same register stay at their
+//  distance so the next split works on the result; joins undo it.
+//
+//  Traits provide: v (register type), lanes, load, store, minmax,
+//  reverse, split<D>, join<D> and transpose (L registers). Only 4 lane
+//  SSE traits exist: wider ones need their own split, join and transpose.
+
+#ifndef PZ_NETWORK_HPP
+#define PZ_NETWORK_HPP
+
+#include <stdint.h>
+#include <emmintrin.h>
+#include <utility>
+
+#define PZ_INLINE inline __attribute__((always_inline))
+
+namespace pz {
+
+constexpr int ilog2(int n) {
+    return n > 1 ? 1 + ilog2(n / 2) : 0;
+}
+
+// Compile time loop, calls f(std::integral_constant<int, I>) for I < N
+template <typename F, int... I>
+PZ_INLINE void unroll(F &&f, std::integer_sequence<int, I...>) {
+    (f(std::integral_constant<int, I>()), ...);
+}
+
+template <int N, typename F>
+PZ_INLINE void unroll(F &&f) {
+    unroll(f, std::make_integer_sequence<int, N>());
+}
+
+//
+// Traits
+//
+
+template <typename T, int L> struct simd;
+
+// Lane exchanges shared by the 4 lane SSE types (as float shuffles)
+struct sse_4lanes {
+    static constexpr int lanes = 4;
+
+    // abcd -> dcba
+    static PZ_INLINE __m128 reverse(__m128 a) {
+        return _mm_shuffle_ps(a, a, 0x1B);
+    }
+
+    //   a = 0 1 2 3  b = 4 5 6 7
+    //   D = 2: a = 0 1 4 5  b = 2 3 6 7
+    //   D = 1: a = 0 2 4 6  b = 1 3 5 7
+    template <int D> static PZ_INLINE void split(__m128 &a, __m128 &b) {
+        __m128 t;
+        if constexpr (D == 2) {
+            t = _mm_movelh_ps(a, b);
+            b = _mm_movehl_ps(b, a);
+        } else {
+            t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            b = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        }
+        a = t;
+    }
+
+    template <int D> static PZ_INLINE void join(__m128 &a, __m128 &b) {
+        __m128 t;
+        if constexpr (D == 2) {
+            t = _mm_movelh_ps(a, b);
+            b = _mm_movehl_ps(b, a);
+        } else {
+            t = _mm_unpacklo_ps(a, b);
+            b = _mm_unpackhi_ps(a, b);
+        }
+        a = t;
+    }
+
+    static PZ_INLINE void transpose(__m128 *v) {
+        __m128 t0 = _mm_unpacklo_ps(v[0], v[1]);
+        __m128 t1 = _mm_unpacklo_ps(v[2], v[3]);
+        __m128 t2 = _mm_unpackhi_ps(v[0], v[1]);
+        __m128 t3 = _mm_unpackhi_ps(v[2], v[3]);
+        v[0] = _mm_movelh_ps(t0, t1);
+        v[1] = _mm_movehl_ps(t1, t0);
+        v[2] = _mm_movelh_ps(t2, t3);
+        v[3] = _mm_movehl_ps(t3, t2);
+    }
+};
+
+// 4 32bit signed integers (SSE2)
+template <> struct simd<int32_t, 4> {
+    typedef __m128i v;
+    typedef sse_4lanes x;
+    static constexpr int lanes = 4;
+
+    static PZ_INLINE v load(const int32_t *p) {
+        return _mm_load_si128((const __m128i *) p);
+    }
+    static PZ_INLINE void store(int32_t *p, v a) {
+        _mm_store_si128((__m128i *) p, a);
+    }
+
+    // SSE2 lacks pmin/pmax for 32bit
+    static PZ_INLINE void minmax(v &a, v &b) {
+        v mask = _mm_cmpgt_epi32(a, b);
+        v t = _mm_and_si128(_mm_xor_si128(a, b), mask);
+        a = _mm_xor_si128(a, t);
+        b = _mm_xor_si128(b, t);
+    }
+
+    static PZ_INLINE v reverse(v a) {
+        return _mm_shuffle_epi32(a, 0x1B);
+    }
+    template <int D> static PZ_INLINE void split(v &a, v &b) {
+        __m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+        x::split<D>(fa, fb);
+        a = _mm_castps_si128(fa);
+        b = _mm_castps_si128(fb);
+    }
+    template <int D> static PZ_INLINE void join(v &a, v &b) {
+        __m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+        x::join<D>(fa, fb);
+        a = _mm_castps_si128(fa);
+        b = _mm_castps_si128(fb);
+    }
+    static PZ_INLINE void transpose(v *r) {
+        x::transpose((__m128 *) r);
+    }
+};
+
+// 4 floats (SSE)
+template <> struct simd<float, 4> {
+    typedef __m128 v;
+    typedef sse_4lanes x;
+    static constexpr int lanes = 4;
+
+    static PZ_INLINE v load(const float *p) {
+        return _mm_load_ps(p);
+    }
+    static PZ_INLINE void store(float *p, v a) {
+        _mm_store_ps(p, a);
+    }
+    static PZ_INLINE void minmax(v &a, v &b) {
+        v t = _mm_min_ps(a, b);
+        b = _mm_max_ps(a, b);
+        a = t;
+    }
+    static PZ_INLINE v reverse(v a) {
+        return x::reverse(a);
+    }
+    template <int D> static PZ_INLINE void split(v &a, v &b) {
+        x::split<D>(a, b);
+    }
+    template <int D> static PZ_INLINE void join(v &a, v &b) {
+        x::join<D>(a, b);
+    }
+    static PZ_INLINE void transpose(v *r) {
+        x::transpose(r);
+    }
+};
+
+//
+// Networks
+//
+
+// Sort each lane across N registers (vertical comparators only)
+//   Bitonic sort with the first stage of each merge flipped, so every
+//   comparator is ascending
+template <typename S, int N>
+struct columns {
+    typedef typename S::v v;
+
+    static PZ_INLINE void sort(v *r) {
+        unroll<ilog2(N)>([&](auto s) {
+            constexpr int K = 2 << decltype(s)::value; // Merge size
+            unroll<N>([&](auto j) {
+                constexpr int b = j & ~(K - 1), o = j - b;
+                if constexpr (o < K / 2)
+                    S::minmax(r[j], r[b + K - 1 - o]);
+            });
+            unroll<ilog2(K) - 1>([&](auto t) {
+                constexpr int D = K >> (decltype(t)::value + 2);
+                unroll<N>([&](auto j) {
+                    if constexpr ((j & D) == 0)
+                        S::minmax(r[j], r[j + D]);
+                });
+            });
+        });
+    }
+};
+
+// Optimal network for 4 (5 comparators)
+template <typename S>
+struct columns<S, 4> {
+    typedef typename S::v v;
+
+    static PZ_INLINE void sort(v *r) {
+        S::minmax(r[0], r[2]);
+        S::minmax(r[1], r[3]);
+        S::minmax(r[0], r[1]);
+        S::minmax(r[2], r[3]);
+        S::minmax(r[1], r[2]);
+    }
+};
+
+template <typename S, int R>
+struct network {
+    typedef typename S::v v;
+    static constexpr int L = S::lanes;
+
+    static_assert(R >= 2 && (R & (R - 1)) == 0,
+            "registers must be a power of 2");
+
+    // Distances inside registers, on a pair of registers
+    template <int D>
+    static PZ_INLINE void lane_stages(v &a, v &b) {
+        S::template split<D>(a, b);
+        S::minmax(a, b);
+        if constexpr (D > 1)
+            lane_stages<D / 2>(a, b);
+        S::template join<D>(a, b);
+    }
+
+    // Ascending merge of a bitonic sequence of R*L elements
+    static PZ_INLINE void bitonic_merge(v *r) {
+        unroll<ilog2(R)>([&](auto s) {
+            constexpr int D = R >> (decltype(s)::value + 1);
+            unroll<R>([&](auto j) {
+                if constexpr ((j & D) == 0)
+                    S::minmax(r[j], r[j + D]);
+            });
+        });
+        unroll<R / 2>([&](auto j) {
+            lane_stages<L / 2>(r[2 * j], r[2 * j + 1]);
+        });
+    }
+
+    // Merge two sorted runs of R/2 registers
+    //   Reversing the second run makes the sequence bitonic
+    static PZ_INLINE void merge(v *r) {
+        unroll<R / 4>([&](auto j) {
+            v t = r[R / 2 + j];
+            r[R / 2 + j] = r[R - 1 - j];
+            r[R - 1 - j] = t;
+        });
+        unroll<R / 2>([&](auto j) {
+            r[R / 2 + j] = S::reverse(r[R / 2 + j]);
+        });
+        bitonic_merge(r);
+    }
+
+    // Sort R*L elements (R multiple of L)
+    //   Column sort and transpose give sorted registers, then runs of
+    //   1, 2, ... R/2 registers are merged
+    static PZ_INLINE void sort(v *r) {
+        static_assert(R % L == 0, "registers must be a multiple of lanes");
+
+        unroll<R / L>([&](auto g) {
+            columns<S, L>::sort(r + g * L);
+            S::transpose(r + g * L);
+        });
+        unroll<ilog2(R)>([&](auto s) {
+            constexpr int W = 1 << decltype(s)::value;
+            unroll<R / (2 * W)>([&](auto j) {
+                network<S, 2 * W>::merge(r + j * 2 * W);
+            });
+        });
+    }
+
+    // Sort R*L elements in memory (aligned)
+    template <typename T>
+    static PZ_INLINE void sort(T *p) {
+        v r[R];
+
+        unroll<R>([&](auto j) { r[j] = S::load(p + j * L); });
+        sort(r);
+        unroll<R>([&](auto j) { S::store(p + j * L, r[j]); });
+    }
+};
+
+} // namespace pz
+
+#undef PZ_INLINE
+
+#endif
@@ -1,7 +1,112 @@
+//  PZ compressor, command line
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  Usage: pz [-d] [-b block size] [-f order] [in [out]]
+//  (stdin and stdout by default, -f 4, 6 or 8 for a fast level)
+
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pz.h"
+
+#define CHUNK (1 << 16)
+
+static int usage(void) {
+    fprintf(stderr, "usage: pz [-d] [-b block size] [-f order] [in [out]]\n");
+    return 2;
+}
+
+// Drain all output waiting in s to f
+static int drain(pz_stream *s, FILE *f) {
+    uint8_t buf[CHUNK];
+    int     k;
+
+    while ((k = pz_drain(s, buf, CHUNK)) > 0)
+        if (fwrite(buf, 1, k, f) != (size_t) k)
+            return -1;
+
+    return k;
+}
 
 int main(int argc, char *argv[]) {
+    static uint8_t buf[PZ_BLOCK];
+    pz_stream *s;
+    FILE      *in = stdin, *out = stdout;
+    int        mode = PZ_COMPRESS, block = 0, level = PZ_BEST, c, n, k, i;
+    int        ret = 1;
+
+    while ((c = getopt(argc, argv, "db:f:")) != -1) {
+        switch (c) {
+        case 'd':
+            mode = PZ_DECOMPRESS;
+            break;
+        case 'b':
+            block = atoi(optarg);
+            break;
+        case 'f':
+            level = atoi(optarg);
+            break;
+        default:
+            return usage();
+        }
+    }
+    if (argc - optind > 2)
+        return usage();
+
+    if (optind < argc && !(in = fopen(argv[optind], "rb"))) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (optind + 1 < argc && !(out = fopen(argv[optind + 1], "wb"))) {
+        perror(argv[optind + 1]);
+        return 1;
+    }
+
+    if (!(s = pz_init(mode, block))) {
+        fprintf(stderr, "pz: can't init (block size %d)\n", block);
+        return 1;
+    }
+    if (mode == PZ_COMPRESS && pz_level(s, level) != 0) {
+        fprintf(stderr, "pz: invalid order %d\n", level);
+        pz_end(s);
+        return 1;
+    }
+
+    while ((n = fread(buf, 1, sizeof (buf), in)) > 0) {
+        for (i = 0; i < n; i += k) {
+            if ((k = pz_feed(s, buf + i, n - i)) < 0 || drain(s, out) < 0)
+                goto out;
+        }
+    }
+
+    if (ferror(in) || pz_flush(s, PZ_FINISH) != 0 || drain(s, out) < 0)
+        goto out;
+
+    ret = 0;
 
-    return 0;
+out:
+    if (ret)
+        fprintf(stderr, "pz: %s\n", ferror(in) ? "read error" :
+                mode == PZ_DECOMPRESS ? "corrupt or truncated input" :
+                "write error");
+    pz_end(s);
+    if (out != stdout && fclose(out) != 0)
+        ret = 1;
 
+    return ret;
 }
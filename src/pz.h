@@ -0,0 +1,203 @@
+//  PZ compressor, public interface
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PZ_H
+#define PZ_H
+
+#include <stdint.h>
+
+// The library is built with hidden symbols, only this interface is exported
+#pragma GCC visibility push(default)
+
+//
+// Streaming compression
+//
+//   Like zlib: input is fed from caller buffers and output drained into
+//   caller buffers. Feeding returns how much was taken, it stops while
+//   output is waiting (at most one block), so drain until it returns 0
+//   and feed the rest. Flushing codes the partial block so far (PZ_FLUSH),
+//   or ends the stream (PZ_FINISH); it needs the output drained first.
+//   For a decoder, PZ_FINISH returns 0 only if the whole stream was read.
+//
+//   block is the compressor's block size in bytes (0 for PZ_BLOCK), the
+//   decoder takes it from the stream. Whole blocks fed at once are coded
+//   without copying them. Feed, drain and flush return -1 on errors
+//   (corrupt data, or a flush with output waiting).
+//
+//   Blocks are compressed with a full BWT (PZ_BEST). Fast levels sort the
+//   rotations only by their next 4 to 8 bytes (PZ_FAST4, 6 and 8): faster,
+//   for some ratio. The level applies from the next block on.
+//
+
+#define PZ_COMPRESS     0
+#define PZ_DECOMPRESS   1
+
+#define PZ_FLUSH        0
+#define PZ_FINISH       1
+
+#define PZ_BEST         0
+#define PZ_FAST4        4
+#define PZ_FAST6        6
+#define PZ_FAST8        8
+
+#define PZ_BLOCK        (1 << 20)
+#define PZ_MAX_BLOCK    (1 << 26)
+
+typedef struct pz_stream pz_stream;
+
+pz_stream *pz_init(int mode, int block);
+int pz_feed(pz_stream *s, const uint8_t *data, int n);
+int pz_drain(pz_stream *s, uint8_t *out, int n);
+int pz_flush(pz_stream *s, int mode);
+void pz_end(pz_stream *s);
+
+// Set the level of a compressor, returns 0 or -1 if not valid
+int pz_level(pz_stream *s, int level);
+
+//
+// Sort n keys of data
+//
+//   With aux (room for n keys) data is merge sorted, both must be 16 byte
+//   aligned. With aux NULL data is sorted in place using a fixed scratch
+//   on the stack. Returns 0.
+//
+
+int pz_sort_i32(int32_t *data, int32_t *aux, int n);
+
+// Same merge sort (with aux) built only with compiler vector extensions,
+// for any target. Returns 0.
+int pz_vec_sort_i32(int32_t *data, int32_t *aux, int n);
+
+//
+// Sort n keys carrying a value each
+//
+//   Without flags pairs are sorted by key, then value. With PZ_SORT_STABLE
+//   equal keys keep their input order (values are not compared).
+//   Returns 0 or -1 on memory error
+//
+
+#define PZ_SORT_STABLE 1
+
+int pz_sort_kv_i32(int32_t *keys, int32_t *vals, int n, int flags);
+
+//
+// Parallel sample sort of n keys of data
+//
+//   Keys are split by sampled splitters into 256 to 1024 buckets that fit
+//   in cache, which are then sorted by the threads. aux has room for n
+//   keys, or NULL to allocate it; same alignment as pz_sort_i32.
+//   Returns 0 or -1 on memory error (data is left unsorted)
+//
+
+int pz_sample_sort_i32(int32_t *data, int32_t *aux, int n, int threads);
+
+//
+// Sorted accumulator
+//
+//   Batches of keys are sorted into runs as they are pushed; runs of similar
+//   size are merged (size-tiered), so every key is merged O(log n) times.
+//   A view merges the remaining runs only when requested.
+//
+
+typedef struct pz_acc pz_acc;
+
+pz_acc *pz_acc_new(void);
+void pz_acc_free(pz_acc *acc);
+
+// Add n keys, returns 0 on success, -1 on memory error
+int pz_acc_push(pz_acc *acc, const int32_t *batch, int n);
+
+// Sorted view of all keys pushed so far, valid until the next push
+//   Returns the number of keys (and sets *keys) or -1 on memory error
+int pz_acc_view(pz_acc *acc, const int32_t **keys);
+
+//
+// Sorted sets of keys
+//
+//   Inputs are sorted, and for intersection and difference also free of
+//   duplicates. dst must have room for na (na + nb for union) elements.
+//   All return the number of elements written to dst.
+//
+
+int pz_unique_i32(int32_t *dst, const int32_t *src, int n); // dst may be src
+int pz_intersect_i32(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb);
+int pz_union_i32(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb);
+int pz_difference_i32(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb);
+
+// Sort n keys of src removing duplicates, writing dst only once
+//   Returns the number of keys or -1 on memory error
+int pz_sort_unique_i32(int32_t *dst, const int32_t *src, int n);
+
+//
+// K-way merge of sorted sequences of any length into out
+//
+//   The parallel version splits the output across threads.
+//   Return the number of keys merged or -1 on memory error
+//
+
+int pz_merge_k_i32(const int32_t *const inputs[], const int lengths[],
+        int k, int32_t *out);
+int pz_merge_k_i32_mt(const int32_t *const inputs[], const int lengths[],
+        int k, int32_t *out, int threads);
+
+//
+// LZ77 match finder
+//
+//   A block (up to PZ_LZ_MAX_BLOCK bytes) is prepared once with a sort of
+//   its positions by 8 byte prefix. Then either all matches of increasing
+//   length at a position are listed (for optimal parsing), or the block
+//   is parsed greedily into sequences of literals followed by a match.
+//   depth is the number of sorted neighbours visited per position.
+//
+
+#define PZ_LZ_MAX_BLOCK (1 << 20)
+
+typedef struct pz_lz pz_lz;
+
+typedef struct {
+    int32_t len;
+    int32_t dist;
+} pz_lz_match;
+
+typedef struct {
+    int32_t lit;    // Literals before the match
+    int32_t len;    // Match length, 0 for trailing literals
+    int32_t dist;
+} pz_lz_seq;
+
+pz_lz *pz_lz_new(int max, int depth);
+void pz_lz_free(pz_lz *lz);
+
+// Returns 0 on success, -1 if n is larger than the block size
+int pz_lz_prepare(pz_lz *lz, const uint8_t *data, int n);
+
+// Matches at pos (nearest first, increasing length), returns count
+int pz_lz_matches(pz_lz *lz, int pos, pz_lz_match *m, int max);
+
+// Greedy parse, seq needs room for n / 4 + 1 and lits for n
+//   Returns number of sequences
+int pz_lz_greedy(pz_lz *lz, pz_lz_seq *seq, uint8_t *lits);
+
+// Rebuild the block from a parse, returns its length
+int pz_lz_decode(const pz_lz_seq *seq, int nseq, const uint8_t *lits,
+        uint8_t *out);
+
+#pragma GCC visibility pop
+
+#endif
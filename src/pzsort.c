@@ -0,0 +1,238 @@
+//  PZ compressor, sort interface
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements the public sort of arrays of any length
+//
+//  With an aux buffer the SSE2 merge sort is used. Without it, the array
+//  is quicksorted in place with the SSE2 partition until pieces fit a
+//  bucket of a fixed scratch buffer (on the stack), where they are sorted
+//  with the bitonic kernels. Keys equal to a pivot that is the minimum
+//  are split off and never partitioned again, so heavy duplicates
+//  terminate. Depth is bounded with a heap sort fallback.
+//
+//  Keys with values are merge sorted as pairs. A stable sort pairs each
+//  key with its position instead, then gathers the values.
+
+#include <stdint.h>
+#include <string.h>
+#include "sse2.h"
+#include "pz.h"
+
+#define BUCKET 4096 // Elements sorted in cache (16KB)
+
+// Insertion sort for short tails
+static void insertion_sort(int32_t *a, int n) {
+    int32_t x;
+    int     i, j;
+
+    for (i = 1; i < n; i++) {
+        x = a[i];
+        for (j = i; j > 0 && a[j - 1] > x; j--)
+            a[j] = a[j - 1];
+        a[j] = x;
+    }
+}
+
+static void sift_down(int32_t *a, int i, int n) {
+    int32_t x = a[i];
+    int     c;
+
+    while ((c = 2 * i + 1) < n) {
+        if (c + 1 < n && a[c + 1] > a[c])
+            c++;
+        if (a[c] <= x)
+            break;
+        a[i] = a[c];
+        i = c;
+    }
+    a[i] = x;
+}
+
+// Fallback for adversarial pivots
+static void heap_sort(int32_t *a, int n) {
+    int32_t x;
+    int     i;
+
+    for (i = n / 2 - 1; i >= 0; i--)
+        sift_down(a, i, n);
+    for (i = n - 1; i > 0; i--) {
+        x = a[0];
+        a[0] = a[i];
+        a[i] = x;
+        sift_down(a, 0, i);
+    }
+}
+
+static int32_t median3(int32_t a, int32_t b, int32_t c) {
+    if (a > b) {
+        int32_t t = a;
+        a = b;
+        b = t;
+    }
+    return c < a ? a : c > b ? b : c;
+}
+
+static int32_t pivot(const int32_t *a, int n) {
+    int s = n / 8;
+
+    if (n < 1024)
+        return median3(a[0], a[n / 2], a[n - 1]);
+
+    return median3(median3(a[0], a[s], a[2 * s]),
+            median3(a[n / 2 - s], a[n / 2], a[n / 2 + s]),
+            median3(a[n - 1 - 2 * s], a[n - 1 - s], a[n - 1]));
+}
+
+// Sort up to BUCKET elements with the bitonic kernels in scratch
+static void bucket_sort(int32_t *a, int n, v4si *v, v4si *aux) {
+    int32_t *p = (int32_t *) v;
+    int      len = ((n + 15) & ~15) / 4, i;
+
+    if (n < 16) {
+        insertion_sort(a, n);
+        return;
+    }
+
+    memcpy(p, a, n * sizeof (int32_t));
+    for (i = n; i < len * 4; i++)
+        p[i] = INT32_MAX;
+
+    memcpy(a, sort_4si_sse2(v, aux, len), n * sizeof (int32_t));
+}
+
+static void quick_sort(int32_t *a, int n, int depth, v4si *v, v4si *aux) {
+    int32_t p;
+    int     m;
+
+    while (n > BUCKET) {
+
+        if (depth-- == 0) {
+            heap_sort(a, n);
+            return;
+        }
+
+        p = pivot(a, n);
+        m = partition_i32_sse2(a, n, p);
+
+        if (m == 0) { // Pivot is the minimum, skip keys equal to it
+            if (p == INT32_MAX)
+                return;
+            m = partition_i32_sse2(a, n, p + 1);
+            a += m;
+            n -= m;
+            continue;
+        }
+
+        // Recurse on the smaller side
+        if (m < n - m) {
+            quick_sort(a, m, depth, v, aux);
+            a += m;
+            n -= m;
+        } else {
+            quick_sort(a + m, n - m, depth, v, aux);
+            n = m;
+        }
+
+    }
+
+    bucket_sort(a, n, v, aux);
+}
+
+int pz_sort_i32(int32_t *data, int32_t *aux, int n) {
+    int32_t  tail[16];
+    v4si    *s;
+    int      m = n & ~15, depth = 0, i;
+
+    if (!aux) { // In place
+        v4si scratch[2][BUCKET / 4];
+
+        for (i = n; i > 1; i >>= 1)
+            depth += 2;
+        quick_sort(data, n, depth, scratch[0], scratch[1]);
+
+        return 0;
+    }
+
+    if (m == 0) {
+        insertion_sort(data, n);
+        return 0;
+    }
+
+    s = sort_4si_sse2((v4si *) data, (v4si *) aux, m / 4);
+
+    if (m == n) {
+        if (s != (v4si *) data)
+            memcpy(data, s, n * sizeof (int32_t));
+        return 0;
+    }
+
+    // Merge the tail into the other buffer
+    memcpy(tail, &data[m], (n - m) * sizeof (int32_t));
+    insertion_sort(tail, n - m);
+
+    if (s == (v4si *) data) {
+        merge_i32_sse2(aux, data, m, tail, n - m, 0);
+        memcpy(data, aux, n * sizeof (int32_t));
+    } else
+        merge_i32_sse2(data, aux, m, tail, n - m, 0);
+
+    return 0;
+}
+
+int pz_sort_kv_i32(int32_t *keys, int32_t *vals, int n, int flags) {
+    v4si    *v, *aux, *s;
+    int32_t *k, *x, *t;
+    int      len = ((n + 15) & ~15) / 4, i;
+
+    if (n < 2)
+        return 0;
+
+    v = _mm_malloc(2 * len * sizeof (v4si), 16);
+    aux = _mm_malloc(2 * len * sizeof (v4si), 16);
+    if (!v || !aux) {
+        _mm_free(v);
+        _mm_free(aux);
+        return -1;
+    }
+
+    k = (int32_t *) v;
+    x = (int32_t *) &v[len];
+    memcpy(k, keys, n * sizeof (int32_t));
+    if (flags & PZ_SORT_STABLE)
+        for (i = 0; i < n; i++)
+            x[i] = i;
+    else
+        memcpy(x, vals, n * sizeof (int32_t));
+    for (i = n; i < len * 4; i++) // Padding goes last
+        k[i] = x[i] = INT32_MAX;
+
+    s = sort_kv_4si_sse2(v, aux, len);
+
+    memcpy(keys, s, n * sizeof (int32_t));
+    if (flags & PZ_SORT_STABLE) {
+        t = (int32_t *) (s == v ? aux : v); // Free, gather from a copy
+        memcpy(t, vals, n * sizeof (int32_t));
+        x = (int32_t *) &s[len];
+        for (i = 0; i < n; i++)
+            vals[i] = t[x[i]];
+    } else
+        memcpy(vals, &s[len], n * sizeof (int32_t));
+
+    _mm_free(v);
+    _mm_free(aux);
+
+    return 0;
+}
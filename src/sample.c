@@ -0,0 +1,381 @@
+//  PZ compressor, parallel sample sort
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements a parallel sample sort
+//
+//  Splitters are picked from a sorted sample and laid out as an implicit
+//  search tree (node i has children 2i and 2i+1). Keys are classified 16
+//  at a time walking the tree branchless: per level each lane loads its
+//  node, pcmpgtd gives -1 if the key is greater, and idx = 2idx - mask.
+//  Bucket b holds the keys with spl[b-1] < key <= spl[b]. Portable
+//  builds walk the tree one key at a time and store lines with memcpy.
+//
+//  Three passes over memory:
+//    1. classify each thread's slice, storing bucket ids and a histogram
+//    2. scatter keys to aux through per bucket line buffers in cache,
+//       flushed a full 64 byte line at a time with streaming stores
+//    3. sort buckets (256 to 1024, sized for cache) from aux back to data
+//       with the bitonic kernels, taken by threads from a shared counter
+//
+//  Buckets holding a single key value are copied, buckets too large for
+//  the scratch (skewed input) are sorted in place.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sse2.h"
+#ifndef PZ_PORTABLE
+#include <emmintrin.h>
+#endif
+#include "pz.h"
+
+#define MIN_LEVELS  8           // 256 buckets
+#define MAX_LEVELS  10          // 1024 buckets
+#define BUCKET_KEYS (1 << 18)   // Target keys per bucket (1MB)
+#define OVERSAMPLE  16          // Sample keys per bucket
+#define MIN_KEYS    (1 << 12)   // Smaller inputs use pz_sort_i32
+#define LINE        16          // Keys per 64 byte line
+
+struct sample_sort {
+    int32_t  *data;
+    int32_t  *aux;
+    uint16_t *id;           // Bucket of each key
+    int       n;
+    int       threads;
+    int       levels;
+    int       buckets;
+    int       cap;          // Keys of the scratch of each thread
+    int32_t   tree[1 << MAX_LEVELS];        // Splitters, node 1 is root
+    int32_t   spl[(1 << MAX_LEVELS) - 1];   // Splitters, sorted
+    int      *hist;         // Keys per thread and bucket, then offsets
+    int      *lo;           // Offsets, kept while hist advances
+    int      *start;        // First key of each bucket in aux
+    int32_t  *wc;           // Line buffers of each thread
+    v4si     *scratch;      // 2 x cap keys for each thread
+    int       next;         // Next bucket to sort
+    pthread_t *tid;         // Thread of each part
+    char     *joined;       // Part ran on its thread
+};
+
+struct sample_part {
+    struct sample_sort *s;
+    int                 t;
+    int                 lo, hi; // Slice of keys
+};
+
+// Fill the tree with the sorted splitters (in order traversal)
+static int build_tree(struct sample_sort *s, int node, int i) {
+    if (node < s->buckets) {
+        i = build_tree(s, 2 * node, i);
+        s->tree[node] = s->spl[i++];
+        i = build_tree(s, 2 * node + 1, i);
+    }
+    return i;
+}
+
+// Splitters from a sorted sample at pseudo random positions
+static int pick_splitters(struct sample_sort *s) {
+    int32_t  *sample;
+    uint32_t  r = 2463534242u;
+    int       k = s->buckets * OVERSAMPLE, i;
+
+    if (!(sample = malloc(k * sizeof (int32_t))))
+        return -1;
+
+    for (i = 0; i < k; i++) {
+        r ^= r << 13; // xorshift
+        r ^= r >> 17;
+        r ^= r << 5;
+        sample[i] = s->data[(uint64_t) r * s->n >> 32];
+    }
+    pz_sort_i32(sample, NULL, k);
+
+    for (i = 0; i < s->buckets - 1; i++)
+        s->spl[i] = sample[(i + 1) * OVERSAMPLE - 1];
+    build_tree(s, 1, 0);
+
+    free(sample);
+
+    return 0;
+}
+
+// Bucket of a key, scalar
+static int classify(const struct sample_sort *s, int32_t x) {
+    int idx = 1, l;
+
+    for (l = 0; l < s->levels; l++)
+        idx = 2 * idx + (x > s->tree[idx]);
+
+    return idx - s->buckets;
+}
+
+// One level of the tree for 4 keys
+//   Node indexes fit 16 bits, so lanes are read with pextrw
+#define TREE_STEP(x, idx) do {                                          \
+        __m128i spl = _mm_set_epi32(tree[_mm_extract_epi16(idx, 6)],    \
+                tree[_mm_extract_epi16(idx, 4)],                        \
+                tree[_mm_extract_epi16(idx, 2)],                        \
+                tree[_mm_extract_epi16(idx, 0)]);                       \
+        idx = _mm_sub_epi32(_mm_add_epi32(idx, idx),                    \
+                _mm_cmpgt_epi32(x, spl));                               \
+    } while (0)
+
+// Pass 1: bucket ids and histogram of a slice
+static void *classify_run(void *arg) {
+    struct sample_part *p = arg;
+    struct sample_sort *s = p->s;
+    int                *hist = &s->hist[p->t * s->buckets];
+    uint16_t           *id = s->id;
+    int                 i = p->lo;
+#ifndef PZ_PORTABLE
+    const int32_t      *tree = s->tree;
+    __m128i             base = _mm_set1_epi32(s->buckets);
+    int                 j, l;
+
+    // 16 keys, 4 independent walks
+    for (; i + 16 <= p->hi; i += 16) {
+        __m128i x0 = _mm_loadu_si128((__m128i *) &s->data[i]);
+        __m128i x1 = _mm_loadu_si128((__m128i *) &s->data[i + 4]);
+        __m128i x2 = _mm_loadu_si128((__m128i *) &s->data[i + 8]);
+        __m128i x3 = _mm_loadu_si128((__m128i *) &s->data[i + 12]);
+        __m128i i0 = _mm_set1_epi32(1), i1 = i0, i2 = i0, i3 = i0;
+
+        for (l = 0; l < s->levels; l++) {
+            TREE_STEP(x0, i0);
+            TREE_STEP(x1, i1);
+            TREE_STEP(x2, i2);
+            TREE_STEP(x3, i3);
+        }
+
+        i0 = _mm_packs_epi32(_mm_sub_epi32(i0, base),
+                _mm_sub_epi32(i1, base));
+        i2 = _mm_packs_epi32(_mm_sub_epi32(i2, base),
+                _mm_sub_epi32(i3, base));
+        _mm_storeu_si128((__m128i *) &id[i], i0);
+        _mm_storeu_si128((__m128i *) &id[i + 8], i2);
+
+        for (j = i; j < i + 16; j++)
+            hist[id[j]]++;
+    }
+#endif
+
+    for (; i < p->hi; i++)
+        hist[id[i] = classify(s, s->data[i])]++;
+
+    return NULL;
+}
+
+#undef TREE_STEP
+
+// Write the keys of the line buffer of a bucket from position lo up to hi
+static void flush_line(int32_t *dst, const int32_t *line, int lo, int hi) {
+    int base = hi & ~(LINE - 1);
+
+    if (hi - base == 0) // Full line ending at hi
+        base -= LINE;
+#ifndef PZ_PORTABLE
+    if (lo <= base && hi - base == LINE &&
+            ((uintptr_t) &dst[base] & 15) == 0) {
+        _mm_stream_si128((__m128i *) &dst[base], *(__m128i *) &line[0]);
+        _mm_stream_si128((__m128i *) &dst[base + 4], *(__m128i *) &line[4]);
+        _mm_stream_si128((__m128i *) &dst[base + 8], *(__m128i *) &line[8]);
+        _mm_stream_si128((__m128i *) &dst[base + 12], *(__m128i *) &line[12]);
+        return;
+    }
+#endif
+    if (lo < base)
+        lo = base;
+    memcpy(&dst[lo], &line[lo - base], (hi - lo) * sizeof (int32_t));
+}
+
+// Pass 2: scatter a slice to aux
+//   Positions of a bucket map to the same offset of its line buffer as of
+//   a line of aux, so full buffers are aligned lines (aux permitting).
+//   Lines shared with the slices of other threads are written partially.
+static void *scatter_run(void *arg) {
+    struct sample_part *p = arg;
+    struct sample_sort *s = p->s;
+    int                *pos = &s->hist[p->t * s->buckets];
+    int                *lo = &s->lo[p->t * s->buckets];
+    int32_t            *wc = &s->wc[p->t * s->buckets * LINE];
+    int                 b, i, q;
+
+    memcpy(lo, pos, s->buckets * sizeof (int));
+
+    for (i = p->lo; i < p->hi; i++) {
+        b = s->id[i];
+        q = pos[b]++;
+        wc[b * LINE + (q & (LINE - 1))] = s->data[i];
+        if ((q & (LINE - 1)) == LINE - 1)
+            flush_line(s->aux, &wc[b * LINE], lo[b], q + 1);
+    }
+
+    // Partial lines left
+    for (b = 0; b < s->buckets; b++)
+        if (pos[b] & (LINE - 1))
+            flush_line(s->aux, &wc[b * LINE], lo[b], pos[b]);
+
+#ifndef PZ_PORTABLE
+    _mm_sfence(); // Streaming stores visible before pass 3
+#endif
+
+    return NULL;
+}
+
+// Pass 3: sort buckets from aux into data
+static void *bucket_run(void *arg) {
+    struct sample_part *p = arg;
+    struct sample_sort *s = p->s;
+    v4si               *v = &s->scratch[p->t * 2 * (s->cap / 4)];
+    v4si               *aux = v + s->cap / 4;
+    int32_t            *d;
+    int                 b, i, m, len;
+
+    while ((b = __sync_fetch_and_add(&s->next, 1)) < s->buckets) {
+
+        d = &s->data[s->start[b]];
+        m = s->start[b + 1] - s->start[b];
+
+        // Single value: spl[b-1] + 1 == spl[b]
+        if (m < 2 || (b > 0 && b < s->buckets - 1 &&
+                (int64_t) s->spl[b - 1] + 1 == s->spl[b])) {
+            memcpy(d, &s->aux[s->start[b]], m * sizeof (int32_t));
+            continue;
+        }
+
+        if (m < 16 || m > s->cap) {
+            memcpy(d, &s->aux[s->start[b]], m * sizeof (int32_t));
+            pz_sort_i32(d, NULL, m);
+            continue;
+        }
+
+        memcpy(v, &s->aux[s->start[b]], m * sizeof (int32_t));
+        len = ((m + 15) & ~15) / 4;
+        for (i = m; i < len * 4; i++)
+            ((int32_t *) v)[i] = INT32_MAX;
+        memcpy(d, sort_4si_sse2(v, aux, len), m * sizeof (int32_t));
+
+    }
+
+    return NULL;
+}
+
+// Run f on every part, the first on the calling thread
+static void run_parts(struct sample_part *part, int threads,
+        void *(*f)(void *)) {
+    pthread_t *tid = part[0].s->tid;
+    char      *joined = part[0].s->joined;
+    int        t;
+
+    for (t = 1; t < threads; t++) {
+        joined[t] = pthread_create(&tid[t], NULL, f, &part[t]) == 0;
+        if (!joined[t])
+            f(&part[t]);
+    }
+    f(&part[0]);
+    for (t = 1; t < threads; t++)
+        if (joined[t])
+            pthread_join(tid[t], NULL);
+}
+
+int pz_sample_sort_i32(int32_t *data, int32_t *aux, int n, int threads) {
+    struct sample_sort *s;
+    struct sample_part *part = NULL;
+    int32_t            *own = NULL;
+    int                 b, t, c, ret = -1;
+
+    if (n < MIN_KEYS)
+        return pz_sort_i32(data, aux, n);
+
+    if (!(s = calloc(1, sizeof (*s))))
+        return -1;
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > n / MIN_KEYS)
+        threads = n / MIN_KEYS;
+
+    for (s->levels = MIN_LEVELS; s->levels < MAX_LEVELS &&
+            (n >> s->levels) > BUCKET_KEYS; s->levels++)
+        ;
+    s->buckets = 1 << s->levels;
+    s->cap = ((2 * (n >> s->levels)) + 15) & ~15;
+    if (s->cap < 1024)
+        s->cap = 1024;
+    s->data = data;
+    s->n = n;
+    s->threads = threads;
+
+    if (!aux)
+        aux = own = _mm_malloc(n * sizeof (int32_t), 64);
+    s->aux = aux;
+    s->id = malloc(n * sizeof (uint16_t));
+    s->hist = calloc(threads * s->buckets, sizeof (int));
+    s->lo = malloc(threads * s->buckets * sizeof (int));
+    s->start = malloc((s->buckets + 1) * sizeof (int));
+    s->wc = _mm_malloc(threads * s->buckets * LINE * sizeof (int32_t), 64);
+    s->scratch = _mm_malloc(threads * 2 * s->cap * sizeof (int32_t), 16);
+    s->tid = malloc(threads * sizeof (pthread_t));
+    s->joined = malloc(threads);
+    part = malloc(threads * sizeof (*part));
+    if (!aux || !s->id || !s->hist || !s->lo || !s->start || !s->wc ||
+            !s->scratch || !s->tid || !s->joined || !part ||
+            pick_splitters(s) != 0)
+        goto out;
+
+    // Slices of lines
+    for (t = 0; t < threads; t++) {
+        part[t].s = s;
+        part[t].t = t;
+        part[t].lo = (int) ((int64_t) n * t / threads) & ~(LINE - 1);
+        part[t].hi = t == threads - 1 ? n :
+                (int) ((int64_t) n * (t + 1) / threads) & ~(LINE - 1);
+    }
+
+    run_parts(part, threads, classify_run);
+
+    // Offsets of each thread in each bucket
+    for (b = 0, c = 0; b < s->buckets; b++) {
+        s->start[b] = c;
+        for (t = 0; t < threads; t++) {
+            int h = s->hist[t * s->buckets + b];
+            s->hist[t * s->buckets + b] = c;
+            c += h;
+        }
+    }
+    s->start[s->buckets] = c;
+
+    run_parts(part, threads, scatter_run);
+    run_parts(part, threads, bucket_run);
+
+    ret = 0;
+
+out:
+    _mm_free(own);
+    free(s->id);
+    free(s->hist);
+    free(s->lo);
+    free(s->start);
+    _mm_free(s->wc);
+    _mm_free(s->scratch);
+    free(s->tid);
+    free(s->joined);
+    free(part);
+    free(s);
+
+    return ret;
+}
@@ -0,0 +1,68 @@
+//  PZ compressor, sorted set operations
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements the public interface of sorted set operations
+
+#include <stdint.h>
+#include <string.h>
+#include "sse2.h"
+#include "pz.h"
+
+int pz_unique_i32(int32_t *dst, const int32_t *src, int n) {
+    return unique_i32_sse2(dst, src, n);
+}
+
+int pz_intersect_i32(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    return intersect_i32_sse2(dst, a, na, b, nb);
+}
+
+int pz_union_i32(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    return merge_i32_sse2(dst, a, na, b, nb, 1);
+}
+
+int pz_difference_i32(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    return difference_i32_sse2(dst, a, na, b, nb);
+}
+
+int pz_sort_unique_i32(int32_t *dst, const int32_t *src, int n) {
+    v4si    *v, *aux;
+    int32_t *p;
+    int      len, i, k = -1;
+
+    if (n <= 0)
+        return 0;
+
+    len = ((n + 15) & ~15) / 4; // Sort works on groups of 4x4
+
+    v = _mm_malloc(len * sizeof (v4si), 16);
+    aux = _mm_malloc(len * sizeof (v4si), 16);
+
+    if (v && aux) {
+        p = (int32_t *) v;
+        memcpy(p, src, n * sizeof (int32_t));
+        for (i = n; i < len * 4; i++) // Padding is dropped as a duplicate
+            p[i] = src[0];
+        k = sort_unique_4si_sse2(dst, n, v, aux, len);
+    }
+
+    _mm_free(v);
+    _mm_free(aux);
+
+    return k;
+}
@@ -3,7 +3,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <unistd.h>
 #include "mm_malloc.h"
+#include "pz.h"
 
 void x264_sort_ssse3(int32_t n, int32_t *dst, int32_t *aux);
 void x264_cri(int n, int32_t *data, int32_t *aux);
@@ -65,48 +67,101 @@ tend= read_time();\
         printf("%"PRIu64"/%"PRIu64" cycles %s, %d runs\n", tsum-NOP_CYCLES*tcount, tother+tsum-NOP_CYCLES*tcount, id, tcount);\
 }}
 
-void sub(int n, sort_f f, char *name) {
+#ifndef PZ_PORTABLE
+void sort_blocks_4si_sse2(int32_t *v, int len);
+
+// Sorting networks only (blocks of 32)
+static void blocks(int32_t n, int32_t *d, int32_t *aux) {
+    sort_blocks_4si_sse2(d, n / 4);
+}
+#endif
+
+static void pz_sort_aux(int32_t n, int32_t *d, int32_t *aux) {
+    pz_sort_i32(d, aux, n);
+}
+
+// Vector extensions only, width set by VEC_WIDTH
+static void pz_vec(int32_t n, int32_t *d, int32_t *aux) {
+    pz_vec_sort_i32(d, aux, n);
+}
+
+static void pz_sort_inplace(int32_t n, int32_t *d, int32_t *aux) {
+    pz_sort_i32(d, NULL, n);
+}
+
+static void pz_sample(int32_t n, int32_t *d, int32_t *aux) {
+    pz_sample_sort_i32(d, aux, n, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+// Keys carry their position as value (aux holds it)
+static void pz_kv(int32_t n, int32_t *d, int32_t *aux) {
+    pz_sort_kv_i32(d, aux, n, 0);
+}
+
+static void pz_kv_stable(int32_t n, int32_t *d, int32_t *aux) {
+    pz_sort_kv_i32(d, aux, n, PZ_SORT_STABLE);
+}
+
+// Time sort f on n random keys (range 0 for full range)
+void sub(int n, int range, sort_f f, char *name) {
     int32_t  *d, *aux;
+    uint64_t best = UINT64_MAX;
     int i, tests;
 
     d = _mm_malloc(n * sizeof (int32_t), 64);
     aux = _mm_malloc(n * sizeof (int32_t), 64);
 
     srandomdev(); // Init random pool
-    for (i = 0; i < n; i++)
-        d[i] = random() % 10;
-
-#ifdef DEBUG
-    for (i = 0; i < 32; i++)
-        printf("%i%c", d[i], (i+1) % 4? ' ' : '\n');
-    printf("--\n");
-#endif
 
     for (tests = 4; tests; tests--) {
+        for (i = 0; i < n; i++) { // Refill, keys were sorted by the last run
+            d[i] = range ? random() % range : random();
+            aux[i] = i;
+        }
         START_TIMER;
         (*f)(n, d, aux);
-        STOP_TIMER("cri");
+        tend = read_time();
+        if (tend - tstart < best)
+            best = tend - tstart;
     }
 
-#ifdef DEBUG
-#define TESTME 32
-    for (i = 0; i < TESTME; i++)
-        d[i] = i % 16; //random() % 10;
-    for (i = 0; i < TESTME; i++)
-        printf("%X%c", d[i], (i+1) % 4 ? ' ' : '\n');
-    printf("\n");
-    x264_cri(TESTME, d);
-    for (i = 0; i < TESTME; i++)
-        printf("%X%c", d[i], (i+1) % 4 ? ' ' : '\n');
-#endif
+    printf("%-10s n=%-9d range=%-6d %6.2f cycles/key\n", name, n, range,
+            (double) best / n);
 
     _mm_free(d);
     _mm_free(aux);
 }
 
 int main(int argc, char *argv[]) {
+    int n;
+
+#ifdef ASM
+    sub((1<<15), 10, x264_cri, "ssse3");
+#endif
+
+#ifndef PZ_PORTABLE
+    sub((1<<15), 0, blocks, "blocks");
+#endif
+
+    for (n = (1<<15); n <= (1<<22); n <<= 7) {
+        sub(n, 0, pz_sort_aux, "aux");
+        sub(n, 0, pz_vec, "vec");
+        sub(n, 0, pz_sort_inplace, "in place");
+        sub(n, 10, pz_sort_aux, "aux");
+        sub(n, 10, pz_vec, "vec");
+        sub(n, 10, pz_sort_inplace, "in place");
+        sub(n, 0, pz_sample, "sample");
+        sub(n, 10, pz_sample, "sample");
+        sub(n, 0, pz_kv, "kv");
+        sub(n, 0, pz_kv_stable, "kv stable");
+        sub(n, 10, pz_kv, "kv");
+        sub(n, 10, pz_kv_stable, "kv stable");
+    }
 
-    sub((1<<15), x264_cri, "ssse3");
+    // Out of cache, where the merge passes over memory add up
+    n = argc > 1 ? atoi(argv[1]) : (1<<26);
+    sub(n, 0, pz_sort_aux, "aux");
+    sub(n, 0, pz_sample, "sample");
 
     return (0);
 }
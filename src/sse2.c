@@ -18,21 +18,10 @@
 
 
 #include <stdint.h>
-#include <xmmintrin.h>
+#include <string.h>
+#include "sse2.h"
 
-// A vector of 4 32bit signed integers (SSE2 128bit register)
-typedef __v4si v4si;
-
-typedef union {
-  int32_t s[4];
-  v4si  v;
-} v4si_u;
-
-static void swap_sse2(v4si *a, v4si *b) {
-    v4si aux = *a;
-    *a = *b;
-    *b = aux;
-}
+#ifndef PZ_PORTABLE // Else built from vec.c
 
 static void reverse_v4_sse2(v4si *a) {
     *a = (v4si) _mm_shuffle_epi32((__m128i) *a, 0x1B); // abcd -> dcab
@@ -46,17 +35,6 @@ static void minmax_4si_sse2(v4si *a, v4si *b) {
     *b ^= t;
 }
 
-// In-register sort of 4
-static void column_sort_4si_sse2(v4si *v) {
-
-    minmax_4si_sse2(&v[0], &v[2]);
-    minmax_4si_sse2(&v[1], &v[3]);
-    minmax_4si_sse2(&v[0], &v[1]);
-    minmax_4si_sse2(&v[2], &v[3]);
-    minmax_4si_sse2(&v[1], &v[2]);
-
-}
-
 // Transpose 4 vectors of 4 32bit elements
 static void transpose_4si_sse2(v4si *v) {
 
@@ -71,14 +49,6 @@ static void transpose_4si_sse2(v4si *v) {
 
 }
 
-// In-register sort of 4 vectors of 32bit signed integers
-static void register_sort_4si_sse2(v4si *v) {
-
-    column_sort_4si_sse2(v); // Sort columns
-    transpose_4si_sse2(v);   // Transpose (a, b, c, d each sorted)
-
-}
-
 //
 // Implementation of a bitonic merge on a 4x4 matrix
 //
@@ -131,207 +101,672 @@ static void bitonic_sort_4si_sse2(v4si *a, v4si *b) {
 
 }
 
-// Parallel bitonic sort for 2+2 vectors
-//   Same as bitonic(&v[0],&v[1]) and bitonic(&v[2],&v[3])
-//   For latency hiding and better reciprocal throughput
-//   aaaa bbbb || cccc dddd
-//   xxxx xxxx    yyyy yyyy
-static void bitonic_sort_2x_4si_sse2(v4si *a, v4si *b, v4si *c, v4si *d) {
+// Merge 2 sorted sequences of vectors of arbitrary (non zero) lengths
+//     Merge sources src1 (len1 vectors) and src2 (len2 vectors) into dst
+void merge_2run_sse2(v4si * restrict dst, v4si * restrict src1, int len1,
+        v4si * restrict src2, int len2) {
+    v4si o1, o2; // Partial output sorted sequence of 8 (4+4)
+    v4si_u *s1 = (v4si_u *) src1; // Need to extract first element
+    v4si_u *s2 = (v4si_u *) src2; // Need to extract first element
+    int i1 = 0; // Position on sequence 1
+    int i2 = 0; // Position on sequence 2
 
-    reverse_v4_sse2(a);
-    reverse_v4_sse2(c);
+    o1 = src1[i1++]; // Take first 4 elements of sequence 1
+    o2 = src2[i2++]; // Take first 4 elements of sequence 2
+    bitonic_sort_4si_sse2(&o1, &o2);
+    *dst++ = o1; // Store first 4 elements in output array
 
-    minmax_4si_sse2(a, b);
-    minmax_4si_sse2(c, d);
+    // While there are remaining elements on both sequences merge lowest
+    while (i1 < len1 && i2 < len2) {
 
-    bitonic_l1_exchange_4si_sse2(a, b); // a-b
-    bitonic_l1_exchange_4si_sse2(c, d); // c-d
+        // Pick lowest
+        if (s1[i1].s[0] < s2[i2].s[0])
+            o1 = s1[i1++].v;
+        else
+            o1 = s2[i2++].v;
 
-    minmax_4si_sse2(a, b);
-    minmax_4si_sse2(c, d);
+        bitonic_sort_4si_sse2(&o1, &o2);
+        *dst++ = o1; // Store in output array
 
-    bitonic_l2_exchange_4si_sse2(a, b); // a-b
-    bitonic_l2_exchange_4si_sse2(c, d); // c-d
+    }
 
-    minmax_4si_sse2(a, b);
-    minmax_4si_sse2(c, d);
+    // Merge remaining (at most one of these runs)
+    while (i1 < len1) {
+        o1 = s1[i1++].v;
+        bitonic_sort_4si_sse2(&o1, &o2);
+        *dst++ = o1;
+    }
+    while (i2 < len2) {
+        o1 = s2[i2++].v;
+        bitonic_sort_4si_sse2(&o1, &o2);
+        *dst++ = o1;
+    }
 
-    bitonic_l3_exchange_4si_sse2(a, b); // a-b
-    bitonic_l3_exchange_4si_sse2(c, d); // c-d
+    *dst++ = o2; // Add last 4 elements
 
 }
 
-// Merge 2 sequences of 2 vectors
-//   aaaa aaaa || bbbb bbbb
-//   0123 4567    89AB CDEF
+// Merge 2 lists of arbitrary size
+//     Merge sources x, y into z
+static void merge_2seq_sse2(v4si * restrict dst, v4si * restrict src1,
+        v4si * restrict src2, int len) {
+    merge_2run_sse2(dst, src1, len, src2, len);
+}
+
+// Sort a sequence of vectors into runs of at least width vectors
+//   len must be multiple of 4 (4x4)
+//   Register sort and bitonic merges build runs of 8 vectors in place,
+//   then runs are merged with merge_2run_sse2 ping-ponging v and aux
+//   Returns the buffer holding the sorted runs (v or aux)
+static v4si *sort_runs_4si_sse2(v4si *v, v4si *aux, int len, int width) {
+    v4si *src = v, *dst = aux, *t;
+    int  i, w;
+
+    sort_blocks_4si_sse2(v, len);
+
+    for (w = 8; w < width; w *= 2) {
+
+        for (i = 0; i < len; i += 2 * w) {
+            if (i + w >= len) // Odd run out, copy
+                memcpy(&dst[i], &src[i], (len - i) * sizeof (v4si));
+            else
+                merge_2run_sse2(&dst[i], &src[i], w, &src[i + w],
+                        (len - i - w) < w ? (len - i - w) : w);
+        }
+
+        t = src; // Swap buffers
+        src = dst;
+        dst = t;
+
+    }
+
+    return src;
+
+}
+
+// Sort a sequence of vectors
+//   len must be multiple of 4 (4x4)
+//   Returns the buffer holding the sorted sequence (v or aux)
+v4si *sort_4si_sse2(v4si *v, v4si *aux, int len) {
+    return sort_runs_4si_sse2(v, aux, len, len);
+}
+
+//
+// Key and value pairs
+//
+//   A sequence of len vectors of keys is followed by len vectors of their
+//   values, lane by lane. Pairs are ordered by key, then by value, so
+//   with unique values (e.g. positions) the order is total and any
+//   network gives the same result: a stable sort of the keys.
 //
-static void merge_2l_2x4si_sse2(v4si *s1, v4si *s2) {
 
-    reverse_v4_sse2(&s2[0]);
-    reverse_v4_sse2(&s2[1]);
-    swap_sse2(&s2[0], &s2[1]);
+// Compare and exchange pairs by key, then value
+static void minmax_kv_4si_sse2(v4si *ka, v4si *xa, v4si *kb, v4si *xb) {
+    v4si mask = (v4si) _mm_or_si128(
+            _mm_cmpgt_epi32((__m128i) *ka, (__m128i) *kb),
+            _mm_and_si128(_mm_cmpeq_epi32((__m128i) *ka, (__m128i) *kb),
+                _mm_cmpgt_epi32((__m128i) *xa, (__m128i) *xb)));
+    v4si t = (*ka ^ *kb) & mask;
+    *ka ^= t;
+    *kb ^= t;
+    t = (*xa ^ *xb) & mask;
+    *xa ^= t;
+    *xb ^= t;
+}
 
-    minmax_4si_sse2(&s1[0], &s2[0]); // L1
-    minmax_4si_sse2(&s1[1], &s2[1]); // L1
+// In-register sort of 4 vectors of pairs (each vector sorted)
+static void register_sort_kv_4si_sse2(v4si *k, v4si *x) {
 
-    bitonic_merge_4x4si_sse2(&s1[0], &s1[1]); // s1
-    bitonic_merge_4x4si_sse2(&s2[0], &s2[1]); // s2
+    minmax_kv_4si_sse2(&k[0], &x[0], &k[2], &x[2]);
+    minmax_kv_4si_sse2(&k[1], &x[1], &k[3], &x[3]);
+    minmax_kv_4si_sse2(&k[0], &x[0], &k[1], &x[1]);
+    minmax_kv_4si_sse2(&k[2], &x[2], &k[3], &x[3]);
+    minmax_kv_4si_sse2(&k[1], &x[1], &k[2], &x[2]);
+    transpose_4si_sse2(k);
+    transpose_4si_sse2(x);
 
 }
 
-static void bitonic_merge_8x8si_sse2(v4si *v) {
+// Bitonic sort of 2 vectors of pairs, as bitonic_sort_4si_sse2
+static void bitonic_sort_kv_4si_sse2(v4si *ka, v4si *xa, v4si *kb, v4si *xb) {
+
+    reverse_v4_sse2(ka);
+    reverse_v4_sse2(xa);
 
-    minmax_4si_sse2(&v[0], &v[2]); // L1  A
-    minmax_4si_sse2(&v[4], &v[6]); // L1  B
-    minmax_4si_sse2(&v[1], &v[3]); // L1  A
-    minmax_4si_sse2(&v[5], &v[7]); // L1  B
+    minmax_kv_4si_sse2(ka, xa, kb, xb);
+    bitonic_l1_exchange_4si_sse2(ka, kb);
+    bitonic_l1_exchange_4si_sse2(xa, xb);
+    minmax_kv_4si_sse2(ka, xa, kb, xb);
+    bitonic_l2_exchange_4si_sse2(ka, kb);
+    bitonic_l2_exchange_4si_sse2(xa, xb);
+    minmax_kv_4si_sse2(ka, xa, kb, xb);
+    bitonic_l3_exchange_4si_sse2(ka, kb);
+    bitonic_l3_exchange_4si_sse2(xa, xb);
 
-    bitonic_merge_4x4si_sse2(&v[0], &v[1]); // Bitonic 4x4si A1  0-1
-    bitonic_merge_4x4si_sse2(&v[4], &v[5]); // Bitonic 4x4si B1  4-5
+}
 
-    bitonic_merge_4x4si_sse2(&v[2], &v[3]); // Bitonic 4x4si A2  2-3
-    bitonic_merge_4x4si_sse2(&v[6], &v[7]); // Bitonic 4x4si B2  6-7
+// First pair of run 1 goes before first pair of run 2
+#define KV_BEFORE(k1, x1, k2, x2) \
+    ((k1).s[0] < (k2).s[0] || ((k1).s[0] == (k2).s[0] && (x1).s[0] < (x2).s[0]))
+
+// Merge 2 sorted runs of pairs, as merge_2run_sse2
+//   Runs of keys k1 (len1) and k2 (len2) have values at x1 and x2
+static void merge_2run_kv_sse2(v4si * restrict dk, v4si * restrict dx,
+        v4si_u *k1, v4si_u *x1, int len1, v4si_u *k2, v4si_u *x2, int len2) {
+    v4si ko1, xo1, ko2, xo2;
+    int  i1 = 0, i2 = 0;
+
+    ko1 = k1[0].v;
+    xo1 = x1[i1++].v;
+    ko2 = k2[0].v;
+    xo2 = x2[i2++].v;
+    bitonic_sort_kv_4si_sse2(&ko1, &xo1, &ko2, &xo2);
+    *dk++ = ko1;
+    *dx++ = xo1;
+
+    while (i1 < len1 || i2 < len2) {
+
+        // Pick lowest (or the remaining run)
+        if (i2 == len2 || (i1 < len1 &&
+                KV_BEFORE(k1[i1], x1[i1], k2[i2], x2[i2]))) {
+            ko1 = k1[i1].v;
+            xo1 = x1[i1++].v;
+        } else {
+            ko1 = k2[i2].v;
+            xo1 = x2[i2++].v;
+        }
+
+        bitonic_sort_kv_4si_sse2(&ko1, &xo1, &ko2, &xo2);
+        *dk++ = ko1;
+        *dx++ = xo1;
+
+    }
+
+    *dk = ko2; // Last 4 pairs
+    *dx = xo2;
 
 }
 
+#undef KV_BEFORE
+
+// Sort a sequence of pairs
+//   v holds len vectors of keys then len vectors of values, aux the same
+//   room; len must be multiple of 4 (4x4)
+//   Returns the buffer holding the sorted pairs (v or aux)
+v4si *sort_kv_4si_sse2(v4si *v, v4si *aux, int len) {
+    v4si *src = v, *dst = aux, *t;
+    int  i, w;
+
+    for (i = 0; i < len; i += 4) {
+        register_sort_kv_4si_sse2(&v[i], &v[len + i]);
+        bitonic_sort_kv_4si_sse2(&v[i], &v[len + i], &v[i + 1],
+                &v[len + i + 1]);
+        bitonic_sort_kv_4si_sse2(&v[i + 2], &v[len + i + 2], &v[i + 3],
+                &v[len + i + 3]);
+    }
 
-// Simultaneous merge of 2 pairs of lists of 2x4si each
-//    v0   v1   v2   v3      v4   v5   v6   v7
-//   aaaa aaaa bbbb bbbb || cccc cccc dddd dddd    (input)
-//   xxxx xxxx xxxx xxxx || yyyy yyyy yyyy yyyy    (result)
-//
-static void merge_parallel_2x2l_2x8si_sse2(v4si *v) {
+    for (w = 2; w < len; w *= 2) {
+
+        for (i = 0; i < len; i += 2 * w) {
+            if (i + w >= len) { // Odd run out, copy
+                memcpy(&dst[i], &src[i], (len - i) * sizeof (v4si));
+                memcpy(&dst[len + i], &src[len + i],
+                        (len - i) * sizeof (v4si));
+            } else
+                merge_2run_kv_sse2(&dst[i], &dst[len + i],
+                        (v4si_u *) &src[i], (v4si_u *) &src[len + i], w,
+                        (v4si_u *) &src[i + w], (v4si_u *) &src[len + i + w],
+                        (len - i - w) < w ? (len - i - w) : w);
+        }
+
+        t = src; // Swap buffers
+        src = dst;
+        dst = t;
 
-    // Prepare by reversing 2nd pairs
-    reverse_v4_sse2(&v[2]); // A
-    reverse_v4_sse2(&v[3]); // A
-    reverse_v4_sse2(&v[6]); // B
-    reverse_v4_sse2(&v[7]); // B
-    swap_sse2(&v[2], &v[3]); // A
-    swap_sse2(&v[6], &v[7]); // B
+    }
 
-    bitonic_merge_8x8si_sse2(v); // 8x8si network
+    return src;
 
 }
 
-// Bitonic merge 2 lists of 4 vectors (16x16si network)
-//    v0   v1   v2   v3      v4   v5   v6   v7
-//   aaaa aaaa aaaa aaaa || bbbb bbbb bbbb bbbb
-//   0123 4567 89AB CDEF    0123 4567 89AB CDEF
 //
-static void bitonic_merge_2x16si_sse2(v4si *v) {
+// Sorted set operations
+//
+//   Kept lanes are compacted with a shuffle by movemask (pshufb on SSSE3,
+//   a lane index table through memory on plain SSE2)
+//
 
-    // Prepare for L1 reversing v4-7
-    reverse_v4_sse2(&v[4]);
-    reverse_v4_sse2(&v[5]);
-    reverse_v4_sse2(&v[6]);
-    reverse_v4_sse2(&v[7]);
-    swap_sse2(&v[4], &v[7]);
-    swap_sse2(&v[5], &v[6]);
+// Lanes selected by mask first, then the rest
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#define LANE(a) 4*a, 4*a+1, 4*a+2, 4*a+3
+#define LANES(a, b, c, d) { LANE(a), LANE(b), LANE(c), LANE(d) }
+static const uint8_t permute_shuffle[16][16] __attribute__((aligned(16))) = {
+    LANES(0,1,2,3), LANES(0,1,2,3), LANES(1,0,2,3), LANES(0,1,2,3),
+    LANES(2,0,1,3), LANES(0,2,1,3), LANES(1,2,0,3), LANES(0,1,2,3),
+    LANES(3,0,1,2), LANES(0,3,1,2), LANES(1,3,0,2), LANES(0,1,3,2),
+    LANES(2,3,0,1), LANES(0,2,3,1), LANES(1,2,3,0), LANES(0,1,2,3)
+};
+#undef LANES
+#undef LANE
+#else
+#define LANES(a, b, c, d) { a, b, c, d }
+static const uint8_t permute_lanes[16][4] = {
+    LANES(0,1,2,3), LANES(0,1,2,3), LANES(1,0,2,3), LANES(0,1,2,3),
+    LANES(2,0,1,3), LANES(0,2,1,3), LANES(1,2,0,3), LANES(0,1,2,3),
+    LANES(3,0,1,2), LANES(0,3,1,2), LANES(1,3,0,2), LANES(0,1,3,2),
+    LANES(2,3,0,1), LANES(0,2,3,1), LANES(1,2,3,0), LANES(0,1,2,3)
+};
+#undef LANES
+#endif
 
-    // L1 compare
-    minmax_4si_sse2(&v[0], &v[4]);
-    minmax_4si_sse2(&v[1], &v[5]);
-    minmax_4si_sse2(&v[2], &v[6]);
-    minmax_4si_sse2(&v[3], &v[7]);
+// Move lanes of a selected by mask (4 bits) to the front
+static inline v4si permute_4si_sse2(v4si a, int mask) {
+#ifdef __SSSE3__
+    return (v4si) _mm_shuffle_epi8((__m128i) a,
+            *(__m128i *) permute_shuffle[mask]);
+#else
+    v4si_u t, r;
+    const uint8_t *l = permute_lanes[mask];
+
+    t.v = a;
+    r.s[0] = t.s[l[0]];
+    r.s[1] = t.s[l[1]];
+    r.s[2] = t.s[l[2]];
+    r.s[3] = t.s[l[3]];
+    return r.v;
+#endif
+}
 
-    bitonic_merge_8x8si_sse2(&v[0]);
-    bitonic_merge_8x8si_sse2(&v[4]);
+// Store lanes of a selected by mask (4 bits) contiguously at dst
+//   Writes 4 elements if dst has room for them, else only the kept ones
+//   Returns number of elements kept
+static inline int compress_store_4si_sse2(int32_t *dst, v4si a, int mask,
+        int room) {
+    v4si_u t;
+    int    k = __builtin_popcount(mask);
+
+    if (room >= 4)
+        _mm_storeu_si128((__m128i *) dst, (__m128i) permute_4si_sse2(a, mask));
+    else {
+        t.v = permute_4si_sse2(a, mask);
+        memcpy(dst, t.s, k * sizeof (int32_t));
+    }
 
+    return k;
 }
 
-// Merge 2 lists of arbitrary size
-//     Merge sources x, y into z
-static void merge_2seq_sse2(v4si * restrict dst, v4si * restrict src1,
-        v4si * restrict src2, int len) {
-    v4si o1, o2; // Partial output sorted sequence of 8 (4+4)
-    v4si_u *s1 = (v4si_u *) src1; // Need to extract first element
-    v4si_u *s2 = (v4si_u *) src2; // Need to extract first element
-    int i1 = 0; // Position on sequence 1
-    int i2 = 0; // Position on sequence 2
+// Mask of lanes different from the previous element (last, a0, a1, a2)
+static inline int unique_mask_4si_sse2(v4si a, int32_t last) {
+    __m128i prev = _mm_or_si128(_mm_slli_si128((__m128i) a, 4),
+            _mm_cvtsi32_si128(last));
+    __m128i eq = _mm_cmpeq_epi32((__m128i) a, prev);
+    return ~_mm_movemask_ps((__m128) eq) & 0xF;
+}
 
-    o1 = src1[i1++]; // Take first 4 elements of sequence 1
-    o2 = src2[i2++]; // Take first 4 elements of sequence 2
-    bitonic_sort_4si_sse2(&o1, &o2);
-    *dst++ = o1; // Store first 4 elements in output array
+// Mask of lanes of a present anywhere in b (all 4 rotations of b)
+static inline int match_mask_4si_sse2(v4si a, v4si b) {
+    __m128i m;
 
-    // While there are remaining elements on both sequences merge lowest
-    for (i1 = 1, i2 = 1; i1 < len && i2 < len; ) {
+    m = _mm_cmpeq_epi32((__m128i) a, (__m128i) b);
+    m = _mm_or_si128(m, _mm_cmpeq_epi32((__m128i) a,
+                _mm_shuffle_epi32((__m128i) b, 0x39)));
+    m = _mm_or_si128(m, _mm_cmpeq_epi32((__m128i) a,
+                _mm_shuffle_epi32((__m128i) b, 0x4E)));
+    m = _mm_or_si128(m, _mm_cmpeq_epi32((__m128i) a,
+                _mm_shuffle_epi32((__m128i) b, 0x93)));
 
-        // Pick lowest
-        if (s1[i1].s[0] < s2[i2].s[0])
-            o1 = s1[i1++].v;
-        else
-            o1 = s2[i2++].v;
+    return _mm_movemask_ps((__m128) m);
+}
 
-        bitonic_sort_4si_sse2(&o1, &o2);
-        *dst++ = o1; // Store in output array
+// Element before x (wraps), never equal to x
+static inline int32_t before_i32(int32_t x) {
+    return (int32_t) ((uint32_t) x - 1);
+}
 
+// Remove duplicates of a sorted sequence, continuing after last
+//   dst may be src and has room for room elements (at least the result)
+static int unique_from_i32_sse2(int32_t *dst, int room, const int32_t *src,
+        int n, int32_t last) {
+    v4si  a;
+    int   i, k = 0;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        a = (v4si) _mm_loadu_si128((__m128i *) &src[i]);
+        k += compress_store_4si_sse2(&dst[k], a,
+                unique_mask_4si_sse2(a, last), room - k);
+        last = _mm_cvtsi128_si32(_mm_shuffle_epi32((__m128i) a, 0xFF));
     }
 
-    // Merge remaining
-    if (i1 < len) {
+    for (; i < n; last = src[i++])
+        if (src[i] != last)
+            dst[k++] = src[i];
 
-        do {
-            o1 = s1[i1++].v;
-            bitonic_sort_4si_sse2(&o1, &o2);
-            *dst++ = o1;
-        } while (i1 < len);
+    return k;
 
-    } else { // i2 < len
+}
+
+// Remove duplicates of a sorted sequence
+//   dst may be src, returns number of elements
+int unique_i32_sse2(int32_t *dst, const int32_t *src, int n) {
+
+    if (n == 0)
+        return 0;
+
+    return unique_from_i32_sse2(dst, n, src, n, before_i32(src[0]));
+
+}
+
+// Intersection of sorted sequences without duplicates
+//   Returns number of elements
+int intersect_i32_sse2(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    v4si    va, vb;
+    int32_t amax, bmax;
+    int     i = 0, j = 0, k = 0;
+
+    if (na >= 4 && nb >= 4) {
+
+        va = (v4si) _mm_loadu_si128((__m128i *) &a[0]);
+        vb = (v4si) _mm_loadu_si128((__m128i *) &b[0]);
+
+        for (;;) {
+
+            // Each lane of a matches at most once, and in order
+            k += compress_store_4si_sse2(&dst[k], va,
+                    match_mask_4si_sse2(va, vb), na - k);
+
+            amax = a[i + 3];
+            bmax = b[j + 3];
+            if (amax <= bmax) {
+                if ((i += 4) + 4 > na)
+                    break;
+                va = (v4si) _mm_loadu_si128((__m128i *) &a[i]);
+            }
+            if (bmax <= amax) {
+                if ((j += 4) + 4 > nb)
+                    break;
+                vb = (v4si) _mm_loadu_si128((__m128i *) &b[j]);
+            }
+
+        }
 
-        do {
-            o1 = s2[i2++].v;
-            bitonic_sort_4si_sse2(&o1, &o2);
-            *dst++ = o1;
-        } while (i2 < len);
     }
 
-    *dst++ = o2; // Add last 4 elements
+    // Remaining, lanes already matched are not found again in b
+    while (i < na && j < nb) {
+        if (a[i] < b[j])
+            i++;
+        else if (a[i] > b[j])
+            j++;
+        else {
+            dst[k++] = a[i++];
+            j++;
+        }
+    }
+
+    return k;
+
+}
+
+// Difference (a minus b) of sorted sequences without duplicates
+//   Returns number of elements
+int difference_i32_sse2(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    v4si    va, vb;
+    int32_t amax, bmax;
+    int     i = 0, j = 0, k = 0;
+    int     found = 0; // Lanes of current va found in b so far
+
+    if (na >= 4 && nb >= 4) {
+
+        va = (v4si) _mm_loadu_si128((__m128i *) &a[0]);
+        vb = (v4si) _mm_loadu_si128((__m128i *) &b[0]);
+
+        for (;;) {
+
+            found |= match_mask_4si_sse2(va, vb);
+
+            amax = a[i + 3];
+            bmax = b[j + 3];
+            if (amax <= bmax) { // va done
+                k += compress_store_4si_sse2(&dst[k], va, ~found & 0xF,
+                        na - k);
+                found = 0;
+                if ((i += 4) + 4 > na)
+                    break;
+                va = (v4si) _mm_loadu_si128((__m128i *) &a[i]);
+            }
+            if (bmax <= amax) {
+                if ((j += 4) + 4 > nb)
+                    break;
+                vb = (v4si) _mm_loadu_si128((__m128i *) &b[j]);
+            }
+
+        }
+
+    }
+
+    // Remaining, skipping lanes of a partially compared va already found
+    for (; i < na; i++, found >>= 1) {
+        if (found & 1)
+            continue;
+        while (j < nb && b[j] < a[i])
+            j++;
+        if (j == nb || b[j] != a[i])
+            dst[k++] = a[i];
+    }
+
+    return k;
 
 }
 
-// Sort registers 4 at a time
-//   len must be multiple of 16 (4x4)
-void register_seq_sort_4si_sse2(v4si *v, int len) {
-    int i;
-    for (i = 0; i < len; i += 4)
-        register_sort_4si_sse2(&v[i]);
+// Merge 2 sorted sequences of arbitrary length, optionally removing
+// duplicates on the way out
+//   Vectors are taken from the sequence with lowest head as in
+//   merge_2seq_sse2; the carry and the short tails are merged scalar.
+//   dst has room for room elements (at least the result)
+//   Returns number of elements
+static int merge_room_i32_sse2(int32_t * restrict dst, int room,
+        const int32_t *a, int na, const int32_t *b, int nb, int unique) {
+    v4si_u  c;      // Carry of highest 4 elements
+    v4si    o1;
+    int32_t last, x;
+    int     i = 0, j = 0, ci = 4, k = 0, m;
+
+    if (na == 0 || nb == 0) { // Single sequence
+        if (na == 0) {
+            a = b;
+            na = nb;
+        }
+        if (unique)
+            return na ? unique_from_i32_sse2(dst, room, a, na,
+                    before_i32(a[0])) : 0;
+        memcpy(dst, a, na * sizeof (int32_t));
+        return na;
+    }
+
+    last = before_i32(a[0] < b[0] ? a[0] : b[0]);
+
+#define EMIT_4SI(v) do {                                                  \
+        if (unique) {                                                     \
+            k += compress_store_4si_sse2(&dst[k], v,                      \
+                    unique_mask_4si_sse2(v, last), room - k);             \
+            last = _mm_cvtsi128_si32(_mm_shuffle_epi32((__m128i) v, 0xFF)); \
+        } else {                                                          \
+            _mm_storeu_si128((__m128i *) &dst[k], (__m128i) v);           \
+            k += 4;                                                       \
+        }                                                                 \
+    } while (0)
+#define EMIT_SI(v) do {                                                   \
+        x = v;                                                            \
+        if (!unique || x != last)                                         \
+            dst[k++] = x;                                                 \
+        last = x;                                                         \
+    } while (0)
+
+    if (na >= 4 && nb >= 4) {
+
+        o1 = (v4si) _mm_loadu_si128((__m128i *) &a[0]);
+        c.v = (v4si) _mm_loadu_si128((__m128i *) &b[0]);
+        i = j = 4;
+        bitonic_sort_4si_sse2(&o1, &c.v);
+        EMIT_4SI(o1);
+
+        // Take whole vectors while the lowest head starts one
+        for (;;) {
+            if (j >= nb || (i < na && a[i] < b[j])) {
+                if (i + 4 > na)
+                    break;
+                o1 = (v4si) _mm_loadu_si128((__m128i *) &a[i]);
+                i += 4;
+            } else {
+                if (j + 4 > nb)
+                    break;
+                o1 = (v4si) _mm_loadu_si128((__m128i *) &b[j]);
+                j += 4;
+            }
+            bitonic_sort_4si_sse2(&o1, &c.v);
+            EMIT_4SI(o1);
+        }
+
+        ci = 0;
+
+    }
+
+    // Scalar 3 way merge while 2 sources remain
+    for (;;) {
+        m = (ci < 4) + (i < na) + (j < nb);
+        if (m < 2)
+            break;
+        if (ci < 4 && (i >= na || c.s[ci] <= a[i]) &&
+                (j >= nb || c.s[ci] <= b[j]))
+            EMIT_SI(c.s[ci++]);
+        else if (i < na && (j >= nb || a[i] <= b[j]))
+            EMIT_SI(a[i++]);
+        else
+            EMIT_SI(b[j++]);
+    }
+
+    // Rest of the only source remaining
+    while (ci < 4)
+        EMIT_SI(c.s[ci++]);
+    if (j < nb) {
+        a = b;
+        i = j;
+        na = nb;
+    }
+    if (unique)
+        k += unique_from_i32_sse2(&dst[k], room - k, &a[i], na - i, last);
+    else {
+        memcpy(&dst[k], &a[i], (na - i) * sizeof (int32_t));
+        k += na - i;
+    }
+
+#undef EMIT_SI
+#undef EMIT_4SI
+
+    return k;
+
+}
+
+// Merge 2 sorted sequences, dst has room for na + nb elements
+int merge_i32_sse2(int32_t * restrict dst, const int32_t *a, int na,
+        const int32_t *b, int nb, int unique) {
+
+    return merge_room_i32_sse2(dst, na + nb, a, na, b, nb, unique);
+
+}
+
+// Sort a sequence of vectors removing duplicates
+//   The last merge writes through the duplicate filter directly to dst
+//   len must be multiple of 4 (4x4), dst has room for n elements (at least
+//   the result), returns number of elements
+int sort_unique_4si_sse2(int32_t *dst, int n, v4si *v, v4si *aux, int len) {
+    v4si *src;
+    int   w = 4;
+
+    while (2 * w < len) // Width of the runs before the last merge
+        w *= 2;
+
+    src = sort_runs_4si_sse2(v, aux, len, w);
+
+    if (w >= len)
+        return unique_from_i32_sse2(dst, n, (int32_t *) src, len * 4,
+                before_i32(src[0][0]));
+
+    return merge_room_i32_sse2(dst, n, (int32_t *) src, w * 4,
+            (int32_t *) &src[w], (len - w) * 4, 1);
+
+}
+
+// Partition n (n >= 8) elements by pivot, elements < pivot first
+//   Each vector read is permuted by its mask and stored whole on both
+//   sides, the first and last vectors (and the odd tail) are held aside
+//   so both sides always have room for a vector
+//   Returns number of elements < pivot
+int partition_i32_sse2(int32_t *a, int n, int32_t pivot) {
+    v4si_u  first, last;
+    int32_t tail[3], x;
+    __m128i p = _mm_set1_epi32(pivot);
+    v4si    y;
+    int     r = n & 3, rl = 4, rr = n - 4 - r, wl = 0, wr = n, m, i;
+
+    first.v = (v4si) _mm_loadu_si128((__m128i *) &a[0]);
+    last.v = (v4si) _mm_loadu_si128((__m128i *) &a[rr]);
+    for (i = 0; i < r; i++)
+        tail[i] = a[n - r + i];
+
+    while (rl < rr) {
+
+        // Read from the side with less room
+        if (rl - wl <= wr - rr) {
+            y = (v4si) _mm_loadu_si128((__m128i *) &a[rl]);
+            rl += 4;
+        } else {
+            rr -= 4;
+            y = (v4si) _mm_loadu_si128((__m128i *) &a[rr]);
+        }
+
+        m = _mm_movemask_ps((__m128) _mm_cmpgt_epi32(p, (__m128i) y));
+        y = permute_4si_sse2(y, m);
+        _mm_storeu_si128((__m128i *) &a[wl], (__m128i) y);
+        _mm_storeu_si128((__m128i *) &a[wr - 4], (__m128i) y);
+        wl += __builtin_popcount(m);
+        wr -= 4 - __builtin_popcount(m);
+
+    }
+
+    // Held aside elements fill the gap exactly
+    for (i = 0; i < 8 + r; i++) {
+        x = i < 4 ? first.s[i] : i < 8 ? last.s[i - 4] : tail[i - 8];
+        if (x < pivot)
+            a[wl++] = x;
+        else
+            a[--wr] = x;
+    }
+
+    return wl;
+
 }
 
 #ifdef TEST
 
 // SSE2 test interfaces
-void pz_column_sort_4si_sse2(v4si *v) {
-    column_sort_4si_sse2(v);
-}
 void pz_transpose_4si_sse2(v4si *v) {
     transpose_4si_sse2(v);
 }
-void pz_register_sort_4si_sse2(v4si *v) {
-    register_sort_4si_sse2(v);
-}
 void pz_bitonic_sort_4si_sse2(v4si *a, v4si *b) {
     bitonic_sort_4si_sse2(a, b);
 }
-void pz_merge_2l_2x4si_sse2(v4si *s1, v4si *s2) {
-    merge_2l_2x4si_sse2(s1, s2);
-}
-void pz_merge_parallel_2x2l_2x8si_sse2(v4si *v) {
-    merge_parallel_2x2l_2x8si_sse2(v);
-}
-void pz_bitonic_sort_2x_4si_sse2(v4si *a, v4si *b, v4si *c, v4si *d) {
-    bitonic_sort_2x_4si_sse2(a, b, c, d);
-}
-void pz_bitonic_merge_2x16si_sse2(v4si *v) {
-    bitonic_merge_2x16si_sse2(v);
-}
 void pz_merge_2seq_sse2(v4si * restrict dst, v4si * restrict src1,
         v4si * restrict src2, int len) {
     merge_2seq_sse2(dst, src1, src2, len);
 }
-void pz_register_seq_sort_4si_sse2(v4si *v, int len) {
-    register_seq_sort_4si_sse2(v, len);
+v4si *pz_sort_4si_sse2(v4si *v, v4si *aux, int len) {
+    return sort_4si_sse2(v, aux, len);
 }
 
 #endif
+
+#endif // PZ_PORTABLE
@@ -0,0 +1,82 @@
+//  PZ compressor, SSE2 methods
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  SSE2 primitives shared with the rest of the compressor
+//
+//  With PZ_PORTABLE, or for targets without SSE2, they are built from the
+//  vector extension kernels of vec.c instead (same names and buffers).
+
+#ifndef PZ_SSE2_H
+#define PZ_SSE2_H
+
+#include <stdint.h>
+
+#if !defined(__SSE2__) && !defined(PZ_PORTABLE)
+#define PZ_PORTABLE
+#endif
+
+#ifdef PZ_PORTABLE
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wattributes" // Clang's nodebug
+#include "mm_malloc.h"
+#pragma GCC diagnostic pop
+
+// A vector of 4 32bit signed integers
+typedef int32_t v4si __attribute__((vector_size(16)));
+#else
+#include <xmmintrin.h>
+
+// A vector of 4 32bit signed integers (SSE2 128bit register)
+typedef __v4si v4si;
+#endif
+
+typedef union {
+  int32_t s[4];
+  v4si  v;
+} v4si_u;
+
+#ifndef PZ_PORTABLE
+// Sort registers 4 at a time (each vector sorted), generated (net.cc)
+void register_seq_sort_4si_sse2(v4si *v, int len);
+
+// Sort blocks of 8 vectors in place, generated (net.cc)
+void sort_blocks_4si_sse2(v4si *v, int len);
+#endif
+
+// Merge 2 sorted sequences of vectors of arbitrary (non zero) lengths
+void merge_2run_sse2(v4si * restrict dst, v4si * restrict src1, int len1,
+        v4si * restrict src2, int len2);
+
+// Sort a sequence of vectors using aux as ping-pong buffer
+v4si *sort_4si_sse2(v4si *v, v4si *aux, int len);
+
+// Sort pairs by key then value, len vectors of keys followed by values
+v4si *sort_kv_4si_sse2(v4si *v, v4si *aux, int len);
+
+// Sorted set operations, return number of elements written
+int unique_i32_sse2(int32_t *dst, const int32_t *src, int n);
+int intersect_i32_sse2(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb);
+int difference_i32_sse2(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb);
+int merge_i32_sse2(int32_t * restrict dst, const int32_t *a, int na,
+        const int32_t *b, int nb, int unique);
+int sort_unique_4si_sse2(int32_t *dst, int n, v4si *v, v4si *aux, int len);
+
+// Partition by pivot, returns number of elements < pivot
+int partition_i32_sse2(int32_t *a, int n, int32_t pivot);
+
+#endif
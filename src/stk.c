@@ -0,0 +1,175 @@
+//  PZ compressor, bounded context block transform
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements the Schindler (ST) transform of order k
+//
+//  As the BWT, but rotations are sorted only by their first k bytes and
+//  then by position. That is one pair sort of (packed context, position)
+//  with no refinement rounds. Past 4 bytes the context doesn't fit a
+//  32bit key, so it is sorted by the bytes after the first 4 and then,
+//  stable, by the first 4 (least significant digit first).
+//
+//  Decoding first finds where contexts change between rows: sorting the
+//  rows by their byte in front of the context is the LF mapping of the
+//  BWT, so k passes over it give the k byte context boundaries, one byte
+//  more each. Then the text is rebuilt backwards. Rows of a context are in
+//  text order, so going backwards each context takes its rows from the
+//  last one down.
+
+#include <stdint.h>
+#include <string.h>
+#include "sse2.h"
+#include "block.h"
+
+#define BUCKET_BITS     12
+#define BUCKETS         (1 << BUCKET_BITS)
+#define BUCKET_SHIFT    (32 - BUCKET_BITS)
+
+// Pack m (up to 4) bytes of the rotation at i, ordered as signed keys
+static inline int32_t pack(const uint8_t *in, int i, int m, int n) {
+    uint32_t x = 0;
+    int      j;
+
+    if (i + m <= n)
+        for (j = 0; j < m; j++)
+            x |= (uint32_t) in[i + j] << (24 - 8 * j);
+    else
+        for (j = 0; j < m; j++)
+            x |= (uint32_t) in[(i + j) % n] << (24 - 8 * j);
+
+    return (int32_t) (x ^ 0x80000000u);
+}
+
+// Sort n pairs of keys and values by key then value
+//   Pairs are first spread by the top bits of their keys (stable), so the
+//   pair sort runs on buckets that fit in cache
+static void sort_buckets(struct block *b, int32_t *key, int32_t *val, int n) {
+    int32_t *tk = b->groups, *tv = b->groups + n;
+    int      count[BUCKETS + 1] = { 0 }, i, j;
+
+    for (i = 0; i < n; i++)
+        count[((uint32_t) key[i] >> BUCKET_SHIFT) + 1]++;
+    for (i = 1; i <= BUCKETS; i++)
+        count[i] += count[i - 1];
+    for (i = 0; i < n; i++) {
+        j = count[(uint32_t) key[i] >> BUCKET_SHIFT]++;
+        tk[j] = key[i];
+        tv[j] = val[i];
+    }
+    memcpy(key, tk, n * sizeof (int32_t));
+    memcpy(val, tv, n * sizeof (int32_t));
+
+    for (i = 0, j = 0; i < BUCKETS; j = count[i++])
+        if (count[i] - j > 1)
+            block_sort_pairs(b, &key[j], &val[j], count[i] - j);
+}
+
+int stk_forward(struct block *b, const uint8_t *in, uint8_t *out, int n,
+        int k) {
+    int32_t *sa = b->sa, *key = b->tmp, *first = b->rank;
+    int      i, primary = 0;
+
+    if (n < 2) {
+        memcpy(out, in, n);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++)
+        sa[i] = i;
+
+    if (k > 4) { // Bytes after the first 4, by position
+        for (i = 0; i < n; i++)
+            key[i] = pack(in, (i + 4) % n, k - 4, n);
+        sort_buckets(b, key, sa, n);
+        memcpy(first, sa, n * sizeof (int32_t));
+        for (i = 0; i < n; i++) { // Then the first 4, by that order
+            key[i] = pack(in, first[i], 4, n);
+            sa[i] = i;
+        }
+        sort_buckets(b, key, sa, n);
+        for (i = 0; i < n; i++)
+            sa[i] = first[sa[i]];
+    } else {
+        for (i = 0; i < n; i++)
+            key[i] = pack(in, i, k, n);
+        sort_buckets(b, key, sa, n);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (sa[i] == 0)
+            primary = i;
+        out[i] = in[(sa[i] + n - 1) % n];
+    }
+
+    return primary;
+}
+
+int stk_inverse(struct block *b, const uint8_t *in, uint8_t *out, int n,
+        int k, int primary) {
+    uint8_t *edge = (uint8_t *) b->v, *next = (uint8_t *) b->aux, *t;
+    int32_t *lf = b->tmp, *group = b->sa, *end = b->rank;
+    int      count[256] = { 0 }, prev[256], i, j, c, last;
+
+    if (primary < 0 || primary >= (n > 0 ? n : 1) || k < 1 || k > 8)
+        return -1;
+
+    for (i = 0; i < n; i++)
+        count[in[i]]++;
+    for (i = 0, j = 0; i < 256; i++) {
+        c = count[i];
+        count[i] = j;
+        j += c;
+    }
+    for (i = 0; i < n; i++)
+        lf[i] = count[in[i]]++;
+
+    // Rows starting a new context, one byte longer each pass
+    //   Rows of a byte are consecutive at LF; two of them split if it is
+    //   the first one, or their shorter contexts split in between
+    memset(edge, 0, n);
+    edge[0] = 1;
+    for (j = 0; j < k; j++) {
+        for (i = 0; i < 256; i++)
+            prev[i] = -1;
+        for (i = 0, last = 0; i < n; i++) {
+            if (edge[i])
+                last = i;
+            c = in[i];
+            next[lf[i]] = prev[c] < 0 || last > prev[c];
+            prev[c] = i;
+        }
+        t = edge;
+        edge = next;
+        next = t;
+    }
+
+    // First row of each row's context, and the end of each context
+    for (i = 0; i < n; i++) {
+        group[i] = edge[i] ? i : group[i - 1];
+        end[group[i]] = i + 1;
+    }
+    for (i = 0; i < n; i++) // Context one position back
+        lf[i] = group[lf[i]];
+
+    for (i = n - 1, j = primary; i >= 0; i--) {
+        out[i] = in[j];
+        c = lf[j];
+        if ((j = --end[c]) < c)
+            return -1;
+    }
+
+    return n;
+}
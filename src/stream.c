@@ -0,0 +1,289 @@
+//  PZ compressor, stream interface
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements streaming compression over the block codec
+//
+//  A stream is a 7 byte header ("PZ", version, block size) followed by
+//  blocks and an empty block at the end. Input is gathered into a block
+//  buffer and coded when full (or flushed); at most one coded block waits
+//  to be drained, so feeding stops until the caller drains it. When the
+//  caller hands over a whole block (or the decoder a whole coded block)
+//  it is coded straight from the caller's buffer, without a copy.
+//
+//  All buffers are allocated once, the decoder's when the header is read.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block.h"
+#include "pz.h"
+
+#define STREAM_HEADER   7
+#define STREAM_VERSION  1
+
+enum { RUNNING, FINISHED, FAILED };
+
+struct pz_stream {
+    int           mode;     // PZ_COMPRESS or PZ_DECOMPRESS
+    int           state;
+    int           max;      // Block size, 0 until the decoder reads it
+    int           level;    // Context order of the ST, 0 for the BWT
+    struct block *b;
+    uint8_t      *in;       // Block being gathered (raw or coded)
+    int           nin;
+    uint8_t       header[STREAM_HEADER];
+    int           nheader;  // Header bytes written or read
+    uint8_t      *out;      // Output waiting to be drained
+    int           pos;
+    int           nout;
+};
+
+static int stream_alloc(pz_stream *s) {
+    int in = s->mode == PZ_COMPRESS ? s->max : BLOCK_BOUND(s->max);
+    int out = s->mode == PZ_COMPRESS ?
+            STREAM_HEADER + BLOCK_BOUND(s->max) + BLOCK_HEADER : s->max;
+
+    s->b = block_new(s->max, s->mode == PZ_COMPRESS);
+    s->in = malloc(in);
+    s->out = malloc(out);
+
+    return s->b && s->in && s->out ? 0 : -1;
+}
+
+pz_stream *pz_init(int mode, int block) {
+    pz_stream *s;
+
+    if (mode != PZ_COMPRESS && mode != PZ_DECOMPRESS)
+        return NULL;
+    if (block == 0)
+        block = PZ_BLOCK;
+    if (block < 1 || block > PZ_MAX_BLOCK)
+        return NULL;
+
+    if (!(s = calloc(1, sizeof (*s))))
+        return NULL;
+    s->mode = mode;
+
+    if (mode == PZ_COMPRESS) {
+        s->max = block;
+        if (stream_alloc(s) != 0) {
+            pz_end(s);
+            return NULL;
+        }
+        s->header[0] = 'P';
+        s->header[1] = 'Z';
+        s->header[2] = STREAM_VERSION;
+        put32(&s->header[3], block);
+    }
+
+    return s;
+}
+
+void pz_end(pz_stream *s) {
+    if (!s)
+        return;
+    block_free(s->b);
+    free(s->in);
+    free(s->out);
+    free(s);
+}
+
+int pz_level(pz_stream *s, int level) {
+    if (s->mode != PZ_COMPRESS || (level != PZ_BEST && level != PZ_FAST4 &&
+            level != PZ_FAST6 && level != PZ_FAST8))
+        return -1;
+    s->level = level;
+
+    return 0;
+}
+
+// Code n bytes of data as the next output, after the header if not sent
+static void emit_block(pz_stream *s, const uint8_t *data, int n) {
+    s->pos = s->nout = 0;
+    if (!s->nheader) {
+        memcpy(s->out, s->header, STREAM_HEADER);
+        s->nout = s->nheader = STREAM_HEADER;
+    }
+    s->nout += block_encode(s->b, data, n, s->out + s->nout, s->level);
+}
+
+static int compress_feed(pz_stream *s, const uint8_t *data, int n) {
+    int used = 0, k;
+
+    while (used < n && s->pos == s->nout) {
+
+        if (s->nin == 0 && n - used >= s->max) { // Whole block, no copy
+            emit_block(s, data + used, s->max);
+            used += s->max;
+            break;
+        }
+
+        k = s->max - s->nin < n - used ? s->max - s->nin : n - used;
+        memcpy(s->in + s->nin, data + used, k);
+        s->nin += k;
+        used += k;
+        if (s->nin == s->max) {
+            emit_block(s, s->in, s->nin);
+            s->nin = 0;
+        }
+
+    }
+
+    return used;
+}
+
+// Read the stream header and allocate for its block size
+static int read_header(pz_stream *s, const uint8_t *data, int n) {
+    int k = STREAM_HEADER - s->nheader < n ? STREAM_HEADER - s->nheader : n;
+
+    memcpy(s->header + s->nheader, data, k);
+    s->nheader += k;
+    if (s->nheader < STREAM_HEADER)
+        return k;
+
+    s->max = get32(&s->header[3]);
+    if (s->header[0] != 'P' || s->header[1] != 'Z' ||
+            s->header[2] != STREAM_VERSION || s->max < 1 ||
+            s->max > PZ_MAX_BLOCK || stream_alloc(s) != 0)
+        return -1;
+
+    return k;
+}
+
+// Decode a whole coded block, the end block finishes the stream
+static int decode_block(pz_stream *s, const uint8_t *in, int raw) {
+    if (raw == 0) {
+        s->state = FINISHED;
+        return 0;
+    }
+    if (block_decode(s->b, in, s->out) != raw)
+        return -1;
+    s->pos = 0;
+    s->nout = raw;
+
+    return 0;
+}
+
+static int decompress_feed(pz_stream *s, const uint8_t *data, int n) {
+    int used = 0, k, raw, payload;
+
+    while (used < n && s->pos == s->nout && s->state == RUNNING) {
+
+        if (s->nheader < STREAM_HEADER) {
+            if ((k = read_header(s, data + used, n - used)) < 0)
+                return -1;
+            used += k;
+            continue;
+        }
+
+        // Whole coded block in data, no copy
+        if (s->nin == 0 && n - used >= BLOCK_HEADER) {
+            if (block_header(s->b, data + used, &raw, &payload) != 0)
+                return -1;
+            if (n - used >= BLOCK_HEADER + payload) {
+                if (decode_block(s, data + used, raw) != 0)
+                    return -1;
+                used += BLOCK_HEADER + payload;
+                continue;
+            }
+        }
+
+        // Gather the header, then the payload
+        k = BLOCK_HEADER;
+        if (s->nin >= BLOCK_HEADER) {
+            if (block_header(s->b, s->in, &raw, &payload) != 0)
+                return -1;
+            k += payload;
+        }
+        k = k - s->nin < n - used ? k - s->nin : n - used;
+        memcpy(s->in + s->nin, data + used, k);
+        s->nin += k;
+        used += k;
+
+        if (s->nin >= BLOCK_HEADER) {
+            if (block_header(s->b, s->in, &raw, &payload) != 0)
+                return -1;
+            if (s->nin == BLOCK_HEADER + payload) {
+                s->nin = 0;
+                if (decode_block(s, s->in, raw) != 0)
+                    return -1;
+            }
+        }
+
+    }
+
+    return used;
+}
+
+int pz_feed(pz_stream *s, const uint8_t *data, int n) {
+    int used;
+
+    if (s->state == FAILED)
+        return -1;
+    if (s->state == FINISHED)
+        return n > 0 ? -1 : 0;
+
+    used = s->mode == PZ_COMPRESS ? compress_feed(s, data, n) :
+            decompress_feed(s, data, n);
+    if (used < 0)
+        s->state = FAILED;
+
+    return used;
+}
+
+int pz_drain(pz_stream *s, uint8_t *out, int n) {
+    int k = s->nout - s->pos < n ? s->nout - s->pos : n;
+
+    if (s->state == FAILED)
+        return -1;
+    if (k == 0)
+        return 0;
+
+    memcpy(out, s->out + s->pos, k);
+    s->pos += k;
+
+    return k;
+}
+
+int pz_flush(pz_stream *s, int mode) {
+    if (s->state == FAILED || s->pos != s->nout)
+        return -1;
+
+    if (s->mode == PZ_DECOMPRESS) // Clean end only after the end block
+        return mode == PZ_FINISH && (s->state != FINISHED || s->nin) ? -1 : 0;
+
+    if (s->state == FINISHED)
+        return 0;
+
+    if (s->nin) {
+        emit_block(s, s->in, s->nin);
+        s->nin = 0;
+    }
+
+    if (mode == PZ_FINISH) {
+        if (s->pos == s->nout) // Nothing was pending
+            s->pos = s->nout = 0;
+        if (!s->nheader) {
+            memcpy(s->out + s->nout, s->header, STREAM_HEADER);
+            s->nout += s->nheader = STREAM_HEADER;
+        }
+        memset(s->out + s->nout, 0, BLOCK_HEADER); // End block
+        s->nout += BLOCK_HEADER;
+        s->state = FINISHED;
+    }
+
+    return 0;
+}
@@ -19,16 +19,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <xmmintrin.h>
-
-typedef __v4si v4si; // For clarity
-
-typedef union {
-  int32_t s[4];
-  v4si  v;
-} v4si_u;
-
+#include <string.h>
+#include "sse2.h"
+#include "pz.h"
+#include "vec.h"
 
+#ifndef PZ_PORTABLE
 // SSE2 test interfaces
 void pz_column_sort_4si_sse2(v4si *v);
 void pz_transpose_4si_sse2(v4si *v);
@@ -41,6 +37,13 @@ void pz_bitonic_merge_2x16si_sse2(v4si *v);
 void pz_merge_2seq_sse2(v4si * restrict dst, v4si * restrict src1,
         v4si * restrict src2, int len);
 void pz_register_seq_sort_4si_sse2(v4si *v, int len);
+v4si *pz_sort_4si_sse2(v4si *v, v4si *aux, int len);
+void pz_sort_blocks_4sf_sse2(__m128 *v, int len);
+#endif
+
+// Vector extension test interfaces
+void pz_sort_lanes_si_vec(vsi *x);
+void pz_bitonic_sort_si_vec(vsi *a, vsi *b);
 
 v4si_u *v, *a; // Buffers vector and aux
 
@@ -82,6 +85,8 @@ int check_sort(int32_t *a, int sequences, int sequence_length) {
 
 }
 
+#ifndef PZ_PORTABLE // Kernels only in sse2.c and net.cc
+
 // Test sorting columns of 4 vectors of 4 32bit signed integers
 int test_column_sort_4() {
     int      i, j;
@@ -351,6 +356,699 @@ int test_sort_registers_32k() {
 
 }
 
+// Test full sort of a sequence of random length (multiple of 16)
+int test_sort_4si() {
+    int32_t  *pa;
+    int      i, len;
+
+    len = 4 * (1 + random() % 512); // Vectors
+    vec_random(len * 4);
+
+    pa = (int32_t *) pz_sort_4si_sse2(&v[0].v, &a[0].v, len);
+
+    for (i = 0; i < len * 4 - 1; i++)
+        if (pa[i] > pa[i + 1]) {
+            printf("test_sort_4si: error at position %d: %d > %d\n",
+                    i, pa[i], pa[i + 1]);
+            return -1;
+        }
+
+    return 0;
+
+}
+
+#endif
+
+// Test accumulator with batches of random size, viewing in between
+int test_acc() {
+    pz_acc        *acc;
+    const int32_t *keys;
+    int32_t       *p = (int32_t *) v;
+    int64_t       sum = 0, vsum;
+    int           i, b, n, total = 0, ret = 0;
+
+    acc = pz_acc_new();
+
+    for (b = 0; b < 16 && ret == 0; b++) {
+
+        n = random() % 1000; // Batch may be empty or not multiple of 4
+        for (i = 0; i < n; i++)
+            p[i] = (b == 3 && i < 8)? INT32_MAX : // Same as padding
+                random() - RAND_MAX / 2;
+        for (i = 0; i < n; i++)
+            sum += p[i];
+        total += n;
+
+        if (pz_acc_push(acc, p, n) != 0 || (b & 1) == 0)
+            continue;
+
+        if (pz_acc_view(acc, &keys) != total) {
+            printf("test_acc: view count error after batch %d\n", b);
+            ret = -1;
+            break;
+        }
+
+        for (i = 0, vsum = 0; i < total; i++) {
+            vsum += keys[i];
+            if (i && keys[i - 1] > keys[i]) {
+                printf("test_acc: error at position %d: %d > %d\n",
+                        i, keys[i - 1], keys[i]);
+                ret = -1;
+                break;
+            }
+        }
+
+        if (ret == 0 && vsum != sum) {
+            printf("test_acc: keys lost after batch %d\n", b);
+            ret = -1;
+        }
+
+    }
+
+    pz_acc_free(acc);
+
+    return ret;
+
+}
+
+int cmp_i32(const void *a, const void *b) {
+    int32_t x = *(const int32_t *) a, y = *(const int32_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Make a sorted sequence without duplicates of random length
+int set_random(int32_t *s, int max) {
+    int32_t x = random() % 8 - 4;
+    int     i, n = random() % max;
+
+    for (i = 0; i < n; i++)
+        s[i] = (x += 1 + random() % 3);
+
+    return n;
+}
+
+// Compare a set operation result with the expected
+int check_set(char *name, int32_t *r, int nr, int32_t *e, int ne) {
+    int i;
+
+    if (nr != ne) {
+        printf("%s: expected %d elements, got %d\n", name, ne, nr);
+        return -1;
+    }
+
+    for (i = 0; i < nr; i++)
+        if (r[i] != e[i]) {
+            printf("%s: error at position %d: %d != %d\n",
+                    name, i, r[i], e[i]);
+            return -1;
+        }
+
+    return 0;
+}
+
+// Test sorted set operations against scalar merges
+//   Results go to heap buffers of exactly the size promised for dst
+int test_set_ops() {
+    int32_t  sa[256], sb[256], e[512], *r, *ra;
+    int      na, nb, i, j, ne, ret = -1;
+
+    na = set_random(sa, 256);
+    nb = set_random(sb, 256);
+    r = malloc((na + nb > 0 ? na + nb : 1) * sizeof (int32_t));
+    ra = malloc((na > 0 ? na : 1) * sizeof (int32_t));
+    if (!r || !ra)
+        goto out;
+
+    // Union
+    for (i = j = ne = 0; i < na || j < nb; )
+        if (j == nb || (i < na && sa[i] < sb[j]))
+            e[ne++] = sa[i++];
+        else if (i == na || sb[j] < sa[i])
+            e[ne++] = sb[j++];
+        else {
+            e[ne++] = sa[i++];
+            j++;
+        }
+    if (check_set("union", r, pz_union_i32(r, sa, na, sb, nb), e, ne) != 0)
+        goto out;
+
+    // Unique of the merge with duplicates
+    for (i = j = ne = 0; i < na || j < nb; )
+        if (j == nb || (i < na && sa[i] <= sb[j]))
+            r[ne++] = sa[i++];
+        else
+            r[ne++] = sb[j++];
+    if (check_set("unique", r, pz_unique_i32(r, r, ne), e,
+                pz_union_i32(e, sa, na, sb, nb)) != 0)
+        goto out;
+
+    // Intersection
+    for (i = j = ne = 0; i < na && j < nb; )
+        if (sa[i] < sb[j])
+            i++;
+        else if (sa[i] > sb[j])
+            j++;
+        else {
+            e[ne++] = sa[i++];
+            j++;
+        }
+    if (check_set("intersect", ra, pz_intersect_i32(ra, sa, na, sb, nb),
+                e, ne) != 0)
+        goto out;
+
+    // Difference
+    for (i = j = ne = 0; i < na; i++) {
+        while (j < nb && sb[j] < sa[i])
+            j++;
+        if (j == nb || sb[j] != sa[i])
+            e[ne++] = sa[i];
+    }
+    if (check_set("difference", ra, pz_difference_i32(ra, sa, na, sb, nb),
+                e, ne) != 0)
+        goto out;
+
+    ret = 0;
+
+out:
+    free(r);
+    free(ra);
+    return ret;
+
+}
+
+// Test sort with duplicate removal on heavy duplicates
+//   dst is a heap buffer of exactly n keys, which distinct keys with the
+//   largest first fill up to the end
+int test_sort_unique() {
+    int32_t  *p = (int32_t *) v, *r;
+    int      i, n, k, range;
+
+    n = random() % 4096;
+    range = 1 + random() % 2048;
+    for (i = 0; i < n; i++)
+        p[i] = random() % range;
+    if (random() % 4 == 0) { // Few distinct keys, the largest first
+        n = 1 + random() % 16;
+        for (i = 0; i < n; i++)
+            p[i] = i;
+        p[0] = n;
+    } else if (n > 0 && random() % 2)
+        p[0] = range;
+
+    if (!(r = malloc((n > 0 ? n : 1) * sizeof (int32_t))))
+        return -1;
+    k = pz_sort_unique_i32(r, p, n);
+
+    for (i = 1; i < k; i++)
+        if (r[i - 1] >= r[i]) {
+            printf("test_sort_unique: error at position %d: %d >= %d\n",
+                    i, r[i - 1], r[i]);
+            free(r);
+            return -1;
+        }
+
+    // Every key must be found
+    for (i = 0; i < n; i++)
+        if (!bsearch(&p[i], r, k, sizeof (int32_t), cmp_i32)) {
+            printf("test_sort_unique: key %d lost\n", p[i]);
+            free(r);
+            return -1;
+        }
+
+    free(r);
+    return 0;
+
+}
+
+// Test k-way merge of sequences of random length, serial and threaded
+int test_merge_k() {
+    const int32_t *in[32];
+    int32_t       *p = (int32_t *) v, *r = (int32_t *) a, *e;
+    int           len[32];
+    int           i, k, n, off, threads;
+
+    k = 1 + random() % 32;
+    for (i = 0, off = 0; i < k; i++) {
+        len[i] = random() % 8 ? random() % 600 : 0;
+        in[i] = &p[off];
+        for (n = 0; n < len[i]; n++)
+            p[off + n] = random() % 1000 - 500;
+        qsort(&p[off], len[i], sizeof (int32_t), cmp_i32);
+        off += len[i];
+    }
+
+    e = &r[off]; // Expected
+    memcpy(e, p, off * sizeof (int32_t));
+    qsort(e, off, sizeof (int32_t), cmp_i32);
+
+    threads = 1 + random() % 4;
+    n = threads > 1 ? pz_merge_k_i32_mt(in, len, k, r, threads) :
+        pz_merge_k_i32(in, len, k, r);
+
+    return check_set("test_merge_k", r, n, e, off);
+
+}
+
+// Test public sort in both modes, random and heavy duplicates
+int test_sort_i32() {
+    int32_t  *p = (int32_t *) v, *e = (int32_t *) a + 65536;
+    int      i, n, inplace = random() & 1;
+
+    n = random() % 4 ? random() % 65536 : random() % 64;
+    for (i = 0; i < n; i++)
+        p[i] = random() & 1 ? random() % 10 : random() - RAND_MAX / 2;
+
+    memcpy(e, p, n * sizeof (int32_t));
+    qsort(e, n, sizeof (int32_t), cmp_i32);
+
+    pz_sort_i32(p, inplace ? NULL : (int32_t *) a, n);
+
+    return check_set(inplace ? "test_sort_i32 (in place)" : "test_sort_i32",
+            p, n, e, n);
+
+}
+
+// Compare (key, value) pairs, or (key, position, value) for stable
+int cmp_kv(const void *a, const void *b) {
+    const int32_t *x = a, *y = b;
+    return x[0] != y[0] ? (x[0] > y[0]) - (x[0] < y[0]) :
+            (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+// Sort pairs, heavy duplicates
+int test_sort_kv() {
+    int32_t  *k = (int32_t *) v, *x = (int32_t *) a, *e;
+    int      i, n, stable = random() & 1, w = stable ? 3 : 2;
+
+    n = random() % 4 ? random() % 65536 : random() % 64;
+    if (!(e = malloc(n * w * sizeof (int32_t) + 1)))
+        return -1;
+    for (i = 0; i < n; i++) {
+        k[i] = e[i * w] = random() & 1 ? random() % 10 : INT32_MAX - i % 2;
+        x[i] = e[i * w + w - 1] = random() % 20 - 10;
+        if (stable)
+            e[i * w + 1] = i;
+    }
+    qsort(e, n, w * sizeof (int32_t), cmp_kv);
+
+    if (pz_sort_kv_i32(k, x, n, stable ? PZ_SORT_STABLE : 0) != 0) {
+        free(e);
+        return -1;
+    }
+
+    for (i = 0; i < n; i++)
+        if (k[i] != e[i * w] || x[i] != e[i * w + w - 1]) {
+            printf("test_sort_kv%s: error at %d of %d: (%d, %d) != (%d, %d)\n",
+                    stable ? " (stable)" : "", i, n, k[i], x[i], e[i * w],
+                    e[i * w + w - 1]);
+            free(e);
+            return -1;
+        }
+
+    free(e);
+
+    return 0;
+
+}
+
+// Sample sort, with skewed keys and thread counts
+int test_sample_sort() {
+    int32_t  *p = (int32_t *) v, *e;
+    int      i, n, ret, threads = 1 + random() % 4, range;
+
+    if (random() % 8 == 0) // Capped by the keys
+        threads = INT32_MAX / 2;
+    n = random() % 4 ? random() % 131072 : random() % 8192;
+    range = random() % 3 ? 0 : random() % 3 ? 10 : 1000;
+    for (i = 0; i < n; i++)
+        p[i] = range ? random() % range : random() - RAND_MAX / 2;
+
+    if (!(e = malloc(n * sizeof (int32_t) + 1)))
+        return -1;
+    memcpy(e, p, n * sizeof (int32_t));
+    qsort(e, n, sizeof (int32_t), cmp_i32);
+
+    ret = pz_sample_sort_i32(p, random() & 1 ? NULL : (int32_t *) a, n,
+            threads);
+    if (ret == 0)
+        ret = check_set("test_sample_sort", p, n, e, n);
+
+    free(e);
+
+    return ret;
+
+}
+
+// Vector extension kernels and sort against qsort and the SSE2 ones
+int test_vec() {
+    int32_t  *p = (int32_t *) v, *q = (int32_t *) v + 65536;
+    int32_t  e[2 * VEC_WIDTH];
+    vsi      x, y;
+    int      i, n;
+
+    for (i = 0; i < 2 * VEC_WIDTH; i++)
+        e[i] = random() % 64 - 32;
+    memcpy(&x, e, sizeof (x));
+    memcpy(&y, &e[VEC_WIDTH], sizeof (y));
+    qsort(e, 2 * VEC_WIDTH, sizeof (int32_t), cmp_i32);
+
+    pz_sort_lanes_si_vec(&x);
+    pz_sort_lanes_si_vec(&y);
+    for (i = 0; i < VEC_WIDTH - 1; i++)
+        if (x[i] > x[i + 1] || y[i] > y[i + 1]) {
+            printf("test_vec: lanes not sorted at %d\n", i);
+            return -1;
+        }
+#if VEC_WIDTH == 4 && !defined(PZ_PORTABLE)
+    a[0].v = x;
+    a[1].v = y;
+    pz_bitonic_sort_4si_sse2(&a[0].v, &a[1].v);
+#endif
+    pz_bitonic_sort_si_vec(&x, &y);
+    memcpy(q, &x, sizeof (x));
+    memcpy(q + VEC_WIDTH, &y, sizeof (y));
+    if (check_set("test_vec (bitonic)", q, 2 * VEC_WIDTH, e, 2 * VEC_WIDTH))
+        return -1;
+#if VEC_WIDTH == 4 && !defined(PZ_PORTABLE)
+    if (check_set("test_vec (bitonic sse2)", (int32_t *) a, 8, q, 8))
+        return -1;
+#endif
+
+    // Same keys through both sorts
+    n = random() % 4 ? random() % 65536 : random() % 64;
+    for (i = 0; i < n; i++)
+        p[i] = q[i] = random() & 1 ? random() % 10 : random() - RAND_MAX / 2;
+
+    pz_sort_i32(p, (int32_t *) a, n);
+    pz_vec_sort_i32(q, (int32_t *) a + 65536, n);
+
+    return check_set("test_vec", q, n, p, n);
+
+}
+
+#ifndef PZ_PORTABLE
+
+// Test generated block sorts, blocks of 32 and an odd block of 16
+int test_network() {
+    int32_t  *p = (int32_t *) v, *q = (int32_t *) a;
+    float    *f = (float *) &a[64];
+    int      i;
+
+    vec_random(256);
+    for (i = 0; i < 256; i++)
+        f[i] = p[i] / 3.0f;
+
+    memcpy(q, p, 176 * sizeof (int32_t));
+    for (i = 0; i < 176; i += 32)
+        qsort(&q[i], i + 32 <= 176 ? 32 : 16, sizeof (int32_t), cmp_i32);
+    sort_blocks_4si_sse2(&v[0].v, 44);
+
+    if (check_set("test_network (blocks)", p, 176, q, 176) != 0)
+        return -1;
+
+    pz_sort_blocks_4sf_sse2((__m128 *) f, 64);
+    for (i = 0; i < 256; i++)
+        if ((i & 31) && f[i - 1] > f[i]) {
+            printf("test_network: float error at position %d\n", i);
+            return -1;
+        }
+
+    return 0;
+
+}
+
+// Sorted random keys, n of them
+static void sorted_random(int32_t *s, int n, int range) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        s[i] = random() % range;
+    qsort(s, n, sizeof (int32_t), cmp_i32);
+}
+
+// Test each vector extension kernel gives the same as the SSE2 one
+//   Lengths are whole vectors of both widths (multiples of 16 keys)
+int test_vec_kernels() {
+    int32_t  *p = (int32_t *) v, *q = (int32_t *) a, *s, *t;
+    int32_t  sa[256], sb[256], m[512], r[512], e[512];
+    int      i, n, l1, l2, na, nb, k;
+
+    // Pairs, keys with duplicates
+    l1 = 4 * (1 + random() % 64);
+    n = 4 * l1;
+    for (i = 0; i < 2 * n; i++)
+        p[i] = q[i] = random() % (i < n ? 64 : 1024);
+    s = (int32_t *) sort_kv_4si_sse2(&v[0].v, &v[2 * l1].v, l1);
+    t = (int32_t *) sort_kv_si_vec((vsi *) q, (vsi *) &q[2 * n],
+            n / VEC_WIDTH);
+    if (check_set("test_vec_kernels (kv)", t, 2 * n, s, 2 * n) != 0)
+        return -1;
+
+    // Runs of vectors
+    l1 = 4 * (1 + random() % 16);
+    l2 = 4 * (1 + random() % 16);
+    sorted_random(p, 4 * l1, 1000);
+    sorted_random(p + 4 * l1, 4 * l2, 1000);
+    merge_2run_sse2(&a[0].v, &v[0].v, l1, &v[l1].v, l2);
+    merge_2run_vec((vsi *) &a[l1 + l2], (vsi *) &v[0], 4 * l1 / VEC_WIDTH,
+            (vsi *) &v[l1], 4 * l2 / VEC_WIDTH);
+    if (check_set("test_vec_kernels (runs)", &q[4 * (l1 + l2)],
+                4 * (l1 + l2), q, 4 * (l1 + l2)) != 0)
+        return -1;
+
+    // Sets, and their merge with duplicates
+    na = set_random(sa, 256);
+    nb = set_random(sb, 256);
+    n = merge_i32_sse2(m, sa, na, sb, nb, 0);
+    if (check_set("test_vec_kernels (merge)", r,
+                merge_i32_vec(r, sa, na, sb, nb, 0), m, n) != 0 ||
+            check_set("test_vec_kernels (union)", r,
+                merge_i32_vec(r, sa, na, sb, nb, 1), e,
+                merge_i32_sse2(e, sa, na, sb, nb, 1)) != 0 ||
+            check_set("test_vec_kernels (unique)", r,
+                unique_i32_vec(r, m, n), e, unique_i32_sse2(e, m, n)) != 0 ||
+            check_set("test_vec_kernels (intersect)", r,
+                intersect_i32_vec(r, sa, na, sb, nb), e,
+                intersect_i32_sse2(e, sa, na, sb, nb)) != 0 ||
+            check_set("test_vec_kernels (difference)", r,
+                difference_i32_vec(r, sa, na, sb, nb), e,
+                difference_i32_sse2(e, sa, na, sb, nb)) != 0)
+        return -1;
+
+    // Sort removing duplicates
+    l1 = 4 * (1 + random() % 32);
+    n = 4 * l1;
+    for (i = 0; i < n; i++)
+        p[i] = q[i] = random() % 256;
+    k = sort_unique_4si_sse2(e, n, &v[0].v, &v[l1].v, l1);
+    if (check_set("test_vec_kernels (sort unique)", r,
+                sort_unique_si_vec(r, n, (vsi *) q, (vsi *) &q[n],
+                    n / VEC_WIDTH), e, k) != 0)
+        return -1;
+
+    // Partition, same split (arrangements differ)
+    n = 8 + random() % 504;
+    for (i = 0; i < n; i++)
+        p[i] = q[i] = random() % 100;
+    k = partition_i32_sse2(p, n, 50);
+    if (partition_i32_vec(q, n, 50) != k) {
+        printf("test_vec_kernels: partition sizes differ\n");
+        return -1;
+    }
+    for (i = 0; i < n; i++)
+        if ((q[i] < 50) != (i < k)) {
+            printf("test_vec_kernels: partition error at %d\n", i);
+            return -1;
+        }
+
+    return 0;
+
+}
+
+#endif
+
+// Make repetitive text, like logs
+int text_random(uint8_t *t, int n) {
+    static const char *w[] = { "GET ", "POST ", "/index.html ", "200 ",
+        "404 ", "{\"id\": ", "\"name\": ", "}\n", "user", "\n" };
+    int i = 0, j, l;
+
+    while (i < n) {
+        if (random() % 4 == 0)
+            t[i++] = 'a' + random() % 26;
+        else {
+            j = random() % 10;
+            l = strlen(w[j]);
+            memcpy(&t[i], w[j], i + l <= n ? l : n - i);
+            i += l;
+        }
+    }
+
+    return n;
+}
+
+// Test LZ matches are real and the greedy parse decodes back
+int test_lz() {
+    static uint8_t  t[65536], lits[65536], out[65536];
+    static pz_lz_seq seq[65536 / 4 + 1];
+    pz_lz_match     m[16];
+    pz_lz           *lz;
+    int             n, i, j, k, l, best, full, nseq, ret = 0;
+
+    // Sometimes a block small enough to check against all positions
+    full = random() % 4 == 0;
+    n = random() % (full ? 4096 : 65536);
+    text_random(t, n);
+
+    lz = pz_lz_new(65536, full ? 65536 : 1 + random() % 32);
+    pz_lz_prepare(lz, t, n);
+
+    for (i = 0; i < n && ret == 0; i += 1 + random() % 64) {
+        k = pz_lz_matches(lz, i, m, 16);
+        for (j = 0; j < k; j++)
+            if (m[j].dist <= 0 || m[j].dist > i || m[j].len < 4 ||
+                    (j && m[j].len <= m[j - 1].len) ||
+                    memcmp(&t[i], &t[i - m[j].dist], m[j].len) != 0) {
+                printf("test_lz: bad match at %d: len %d dist %d\n",
+                        i, m[j].len, m[j].dist);
+                ret = -1;
+                break;
+            }
+        if (!full || ret != 0)
+            continue;
+        for (j = 0, best = 3; j < i; j++) {
+            for (l = 0; i + l < n && t[j + l] == t[i + l]; l++)
+                ;
+            best = l > best ? l : best;
+        }
+        if ((k ? m[k - 1].len : 3) != best) {
+            printf("test_lz: longest match at %d is %d, found %d\n",
+                    i, best, k ? m[k - 1].len : 0);
+            ret = -1;
+        }
+    }
+
+    nseq = pz_lz_greedy(lz, seq, lits);
+    if (ret == 0 && (pz_lz_decode(seq, nseq, lits, out) != n ||
+                memcmp(t, out, n) != 0)) {
+        printf("test_lz: greedy parse of %d bytes does not decode\n", n);
+        ret = -1;
+    }
+
+    pz_lz_free(lz);
+
+    return ret;
+
+}
+
+// Pass n bytes through s fed and drained in random chunks
+//   Returns bytes written to out (room for max) or -1 on error
+int stream_pass(pz_stream *s, const uint8_t *in, int n, uint8_t *out,
+        int max, int flush) {
+    int i = 0, o = 0, k, done = 0;
+
+    for (;;) {
+
+        do {
+            k = 1 + random() % 1000;
+            k = k < max - o ? k : max - o;
+            if ((k = pz_drain(s, out + o, k)) < 0)
+                return -1;
+            o += k;
+        } while (k > 0);
+
+        if (done)
+            break;
+
+        // Nothing is pending here, so flushing can't fail
+        if (i < n) {
+            if (flush && random() % 8 == 0 && pz_flush(s, PZ_FLUSH) != 0)
+                return -1;
+            k = random() % 4 ? 1 + random() % (n - i) : n - i;
+            if ((k = pz_feed(s, in + i, k)) < 0)
+                return -1;
+            i += k;
+        } else if (pz_flush(s, PZ_FINISH) == 0)
+            done = 1;
+        else
+            return -1;
+
+    }
+
+    return o;
+}
+
+// Compress and decompress texts, random bytes and runs, at all levels
+int test_stream() {
+    static const int levels[] = { PZ_BEST, PZ_FAST4, PZ_FAST6, PZ_FAST8 };
+    uint8_t   *t, *z, *out;
+    pz_stream *c, *d;
+    int        n, i, k, block, level = levels[random() % 4], ret = -1;
+
+    n = random() % 4 ? random() % 200000 : random() % 64;
+    block = random() % 4 ? 16 + random() % 8192 : random() % 2 ? 0 : n + 1;
+    t = malloc(n + 1);
+    z = malloc(2 * n + 1024);
+    out = malloc(n + 1);
+    c = pz_init(PZ_COMPRESS, block);
+    d = pz_init(PZ_DECOMPRESS, 0);
+    if (!t || !z || !out || !c || !d || pz_level(c, level) != 0 ||
+            pz_level(d, level) == 0 || pz_level(c, 3) == 0 ||
+            pz_level(c, 5) == 0 || pz_level(c, 7) == 0 ||
+            pz_level(c, 9) == 0)
+        goto out;
+
+    switch (random() % 4) {
+    case 0:
+        for (i = 0; i < n; i++)
+            t[i] = random();
+        break;
+    case 1:
+        memset(t, random(), n);
+        break;
+    case 2:
+        for (i = 0; i < n; i++)
+            t[i] = "ab\n"[i % (1 + random() % 3)];
+        break;
+    default:
+        text_random(t, n);
+    }
+
+    if ((k = stream_pass(c, t, n, z, 2 * n + 1024, 1)) < 0) {
+        printf("test_stream: compression of %d bytes failed\n", n);
+        goto out;
+    }
+    if (stream_pass(d, z, k, out, n, 0) != n || memcmp(t, out, n) != 0) {
+        printf("test_stream: %d bytes (block %d, level %d) do not "
+                "decompress\n", n, block, level);
+        goto out;
+    }
+
+    // Truncated streams are not complete
+    if (k > 1) {
+        pz_end(d);
+        d = pz_init(PZ_DECOMPRESS, 0);
+        if (pz_feed(d, z, k - 1) == k - 1 && pz_flush(d, PZ_FINISH) == 0)
+            while (pz_drain(d, out, n) > 0)
+                ;
+        if (pz_flush(d, PZ_FINISH) == 0) {
+            printf("test_stream: truncated stream accepted\n");
+            goto out;
+        }
+    }
+
+    ret = 0;
+
+out:
+    pz_end(c);
+    pz_end(d);
+    free(t);
+    free(z);
+    free(out);
+
+    return ret;
+
+}
 
 int run_test(int (*f)(void), char *name, int reps) {
     int i;
@@ -375,6 +1073,7 @@ int main(int argc, char *argv[]) {
 
     srandomdev(); // Init random pool from random device
 
+#ifndef PZ_PORTABLE
     run_test(test_column_sort_4, "test_column_sort_4", t);
     run_test(test_register_sort_4, "test_register_sort_4", t);
     run_test(test_bitonic_sort, "test_bitonic_sort", t);
@@ -385,6 +1084,22 @@ int main(int argc, char *argv[]) {
     run_test(test_merge_16x16, "test_merge_16x16", t);
     run_test(test_merge_2seq, "test_merge_2seq", t);
     run_test(test_sort_registers_32k, "test_sort_registers_32k", 512);
+    run_test(test_sort_4si, "test_sort_4si", 512);
+#endif
+    run_test(test_acc, "test_acc", 512);
+    run_test(test_set_ops, "test_set_ops", t);
+    run_test(test_sort_unique, "test_sort_unique", 512);
+    run_test(test_merge_k, "test_merge_k", 2048);
+    run_test(test_sort_i32, "test_sort_i32", 512);
+    run_test(test_sample_sort, "test_sample_sort", 256);
+    run_test(test_sort_kv, "test_sort_kv", 512);
+#ifndef PZ_PORTABLE
+    run_test(test_network, "test_network", t);
+    run_test(test_vec_kernels, "test_vec_kernels", t);
+#endif
+    run_test(test_vec, "test_vec", 1024);
+    run_test(test_lz, "test_lz", 256);
+    run_test(test_stream, "test_stream", 256);
 
     _mm_free(v);
     _mm_free(a);
@@ -0,0 +1,590 @@
+//  PZ compressor, portable vector methods
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  This file implements the bitonic merge sort with vector extensions
+//
+//  No intrinsics: compares are vector operators and lanes move with
+//  __builtin_shufflevector, so it builds for any target and width. It is
+//  the reference the SSE2 kernels are tested against, and the sort for
+//  hosts without them.
+//
+//  Each vector is sorted across its lanes with a bitonic network. A lane
+//  step at distance d compares every lane with lane ^ d, a constant mask
+//  tells which lanes keep the minimum. Runs are merged two vectors at a
+//  time as in merge_2run_sse2, where both vectors take each step at once.
+//
+//  The other kernels of sse2.c follow: pairs sort the same way with a
+//  lexicographic compare, the sorted set operations and the partition are
+//  scalar (no portable compress store). With PZ_PORTABLE (or no SSE2) the
+//  library is built with these in place of sse2.c, under its names.
+
+#include <stdint.h>
+#include <string.h>
+#include "sse2.h"
+#include "vec.h"
+#include "pz.h"
+
+#if defined(PZ_PORTABLE) && VEC_WIDTH != 4
+#error "PZ_PORTABLE builds vectors of 4 lanes, as the SSE2 ones"
+#endif
+
+#if defined(__clang__) || __GNUC__ >= 12
+#define SHUFFLE2(x, y, ...) __builtin_shufflevector(x, y, __VA_ARGS__)
+#else
+#define SHUFFLE2(x, y, ...) __builtin_shuffle(x, y, (vsi) { __VA_ARGS__ })
+#endif
+#define SHUFFLE(x, ...) SHUFFLE2(x, x, __VA_ARGS__)
+
+// Lane orders by width
+//   XORd pairs each lane with the one at distance d. Of 2 vectors a and b,
+//   LOd takes the lanes with bit d clear (first of their pair) and HId
+//   the others, ZIPAd and ZIPBd put them back in place
+#if VEC_WIDTH == 4
+#define LANES_IOTA      0, 1, 2, 3
+#define LANES_REVERSE   3, 2, 1, 0
+#define LANES_XOR1      1, 0, 3, 2
+#define LANES_XOR2      2, 3, 0, 1
+#define LANES_LO2       0, 1, 4, 5
+#define LANES_HI2       2, 3, 6, 7
+#define LANES_ZIPA2     0, 1, 4, 5
+#define LANES_ZIPB2     2, 3, 6, 7
+#define LANES_LO1       0, 2, 4, 6
+#define LANES_HI1       1, 3, 5, 7
+#define LANES_ZIPA1     0, 4, 1, 5
+#define LANES_ZIPB1     2, 6, 3, 7
+#elif VEC_WIDTH == 8
+#define LANES_IOTA      0, 1, 2, 3, 4, 5, 6, 7
+#define LANES_REVERSE   7, 6, 5, 4, 3, 2, 1, 0
+#define LANES_XOR1      1, 0, 3, 2, 5, 4, 7, 6
+#define LANES_XOR2      2, 3, 0, 1, 6, 7, 4, 5
+#define LANES_XOR4      4, 5, 6, 7, 0, 1, 2, 3
+#define LANES_LO4       0, 1, 2, 3, 8, 9, 10, 11
+#define LANES_HI4       4, 5, 6, 7, 12, 13, 14, 15
+#define LANES_ZIPA4     0, 1, 2, 3, 8, 9, 10, 11
+#define LANES_ZIPB4     4, 5, 6, 7, 12, 13, 14, 15
+#define LANES_LO2       0, 1, 4, 5, 8, 9, 12, 13
+#define LANES_HI2       2, 3, 6, 7, 10, 11, 14, 15
+#define LANES_ZIPA2     0, 1, 8, 9, 2, 3, 10, 11
+#define LANES_ZIPB2     4, 5, 12, 13, 6, 7, 14, 15
+#define LANES_LO1       0, 2, 4, 6, 8, 10, 12, 14
+#define LANES_HI1       1, 3, 5, 7, 9, 11, 13, 15
+#define LANES_ZIPA1     0, 8, 1, 9, 2, 10, 3, 11
+#define LANES_ZIPB1     4, 12, 5, 13, 6, 14, 7, 15
+#else
+#define LANES_IOTA      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+#define LANES_REVERSE   15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+#define LANES_XOR1      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+#define LANES_XOR2      2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13
+#define LANES_XOR4      4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8, 9, 10, 11
+#define LANES_XOR8      8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7
+#define LANES_LO8       0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23
+#define LANES_HI8       8, 9, 10, 11, 12, 13, 14, 15, \
+        24, 25, 26, 27, 28, 29, 30, 31
+#define LANES_ZIPA8     0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23
+#define LANES_ZIPB8     8, 9, 10, 11, 12, 13, 14, 15, \
+        24, 25, 26, 27, 28, 29, 30, 31
+#define LANES_LO4       0, 1, 2, 3, 8, 9, 10, 11, \
+        16, 17, 18, 19, 24, 25, 26, 27
+#define LANES_HI4       4, 5, 6, 7, 12, 13, 14, 15, \
+        20, 21, 22, 23, 28, 29, 30, 31
+#define LANES_ZIPA4     0, 1, 2, 3, 16, 17, 18, 19, 4, 5, 6, 7, 20, 21, 22, 23
+#define LANES_ZIPB4     8, 9, 10, 11, 24, 25, 26, 27, \
+        12, 13, 14, 15, 28, 29, 30, 31
+#define LANES_LO2       0, 1, 4, 5, 8, 9, 12, 13, \
+        16, 17, 20, 21, 24, 25, 28, 29
+#define LANES_HI2       2, 3, 6, 7, 10, 11, 14, 15, \
+        18, 19, 22, 23, 26, 27, 30, 31
+#define LANES_ZIPA2     0, 1, 16, 17, 2, 3, 18, 19, 4, 5, 20, 21, 6, 7, 22, 23
+#define LANES_ZIPB2     8, 9, 24, 25, 10, 11, 26, 27, \
+        12, 13, 28, 29, 14, 15, 30, 31
+#define LANES_LO1       0, 2, 4, 6, 8, 10, 12, 14, \
+        16, 18, 20, 22, 24, 26, 28, 30
+#define LANES_HI1       1, 3, 5, 7, 9, 11, 13, 15, \
+        17, 19, 21, 23, 25, 27, 29, 31
+#define LANES_ZIPA1     0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23
+#define LANES_ZIPB1     8, 24, 9, 25, 10, 26, 11, 27, \
+        12, 28, 13, 29, 14, 30, 15, 31
+#endif
+
+static inline void minmax_si_vec(vsi *a, vsi *b) {
+    vsi t = (*a ^ *b) & (*a > *b);
+    *a ^= t;
+    *b ^= t;
+}
+
+// Lanes of x exchanged with the lanes at distance d
+static inline void partner_si_vec(vsi *y, const vsi *x, int d) {
+    switch (d) {
+    case 1:
+        *y = SHUFFLE(*x, LANES_XOR1);
+        break;
+    case 2:
+        *y = SHUFFLE(*x, LANES_XOR2);
+        break;
+#if VEC_WIDTH >= 8
+    case 4:
+        *y = SHUFFLE(*x, LANES_XOR4);
+        break;
+#endif
+#if VEC_WIDTH >= 16
+    case 8:
+        *y = SHUFFLE(*x, LANES_XOR8);
+        break;
+#endif
+    default:
+        *y = *x;
+    }
+}
+
+// Compare each lane with the one at distance d in a bitonic step of size k
+//   Lane i keeps the minimum if first of its pair (i & d clear), unless
+//   it sorts descending (i & k set); with k the whole vector all ascend
+static inline void exchange_si_vec(vsi *x, int d, int k) {
+    const vsi lane = { LANES_IOTA };
+    vsi lo = ((lane & d) == 0) == ((lane & k) == 0);
+    vsi y, take;
+
+    partner_si_vec(&y, x, d);
+    take = ((*x > y) & lo) | ((y > *x) & ~lo);
+    *x ^= (*x ^ y) & take;
+}
+
+// Sort the lanes of a vector
+static inline void sort_lanes_si_vec(vsi *x) {
+    int k, d;
+
+    for (k = 2; k <= VEC_WIDTH; k *= 2)
+        for (d = k / 2; d > 0; d /= 2)
+            exchange_si_vec(x, d, k);
+}
+
+// Compare the lanes at distance d of both a and b, minimum first
+//   The pairs are gathered in 2 vectors to compare all at once
+#define EXCHANGE_2(a, b, d) {                                       \
+    vsi l = SHUFFLE2(*a, *b, LANES_LO##d);                          \
+    vsi h = SHUFFLE2(*a, *b, LANES_HI##d);                          \
+    minmax_si_vec(&l, &h);                                          \
+    *a = SHUFFLE2(l, h, LANES_ZIPA##d);                             \
+    *b = SHUFFLE2(l, h, LANES_ZIPB##d);                             \
+}
+
+// Bitonic sort of 2 sorted vectors, lowest half to a
+static inline void bitonic_sort_si_vec(vsi *a, vsi *b) {
+
+    *b = SHUFFLE(*b, LANES_REVERSE);
+    minmax_si_vec(a, b);
+#if VEC_WIDTH >= 16
+    EXCHANGE_2(a, b, 8);
+#endif
+#if VEC_WIDTH >= 8
+    EXCHANGE_2(a, b, 4);
+#endif
+    EXCHANGE_2(a, b, 2);
+    EXCHANGE_2(a, b, 1);
+
+}
+
+#undef EXCHANGE_2
+
+// Merge 2 sorted sequences of vectors of arbitrary (non zero) lengths
+//     Merge sources src1 (len1 vectors) and src2 (len2 vectors) into dst
+void merge_2run_vec(vsi * restrict dst, vsi * restrict src1, int len1,
+        vsi * restrict src2, int len2) {
+    vsi o1, o2;
+    int i1 = 0, i2 = 0;
+
+    o1 = src1[i1++];
+    o2 = src2[i2++];
+    bitonic_sort_si_vec(&o1, &o2);
+    *dst++ = o1;
+
+    while (i1 < len1 || i2 < len2) {
+
+        // Pick lowest (or the remaining run)
+        if (i2 == len2 || (i1 < len1 && src1[i1][0] < src2[i2][0]))
+            o1 = src1[i1++];
+        else
+            o1 = src2[i2++];
+
+        bitonic_sort_si_vec(&o1, &o2);
+        *dst++ = o1;
+
+    }
+
+    *dst = o2; // Last vector
+
+}
+
+// Sort a sequence of vectors
+//   Returns the buffer holding the sorted sequence (v or aux)
+vsi *sort_si_vec(vsi *v, vsi *aux, int len) {
+    vsi *src = v, *dst = aux, *t;
+    int  i, w;
+
+    for (i = 0; i < len; i++)
+        sort_lanes_si_vec(&v[i]);
+
+    for (w = 1; w < len; w *= 2) {
+
+        for (i = 0; i < len; i += 2 * w) {
+            if (i + w >= len) // Odd run out, copy
+                memcpy(&dst[i], &src[i], (len - i) * sizeof (vsi));
+            else
+                merge_2run_vec(&dst[i], &src[i], w, &src[i + w],
+                        (len - i - w) < w ? (len - i - w) : w);
+        }
+
+        t = src; // Swap buffers
+        src = dst;
+        dst = t;
+
+    }
+
+    return src;
+
+}
+
+// Insertion sort for the tail
+static void insertion_sort(int32_t *a, int n) {
+    int32_t x;
+    int     i, j;
+
+    for (i = 1; i < n; i++) {
+        x = a[i];
+        for (j = i; j > 0 && a[j - 1] > x; j--)
+            a[j] = a[j - 1];
+        a[j] = x;
+    }
+}
+
+int pz_vec_sort_i32(int32_t *data, int32_t *aux, int n) {
+    int32_t  tail[VEC_WIDTH], *s, *dst;
+    int      m = n - n % VEC_WIDTH, i, j, k;
+
+    if (m == 0) {
+        insertion_sort(data, n);
+        return 0;
+    }
+
+    s = (int32_t *) sort_si_vec((vsi *) data, (vsi *) aux, m / VEC_WIDTH);
+
+    if (m == n) {
+        if (s != data)
+            memcpy(data, s, n * sizeof (int32_t));
+        return 0;
+    }
+
+    // Merge the tail into the other buffer
+    memcpy(tail, &data[m], (n - m) * sizeof (int32_t));
+    insertion_sort(tail, n - m);
+
+    dst = s == data ? aux : data;
+    for (i = j = k = 0; k < n; k++)
+        dst[k] = j == n - m || (i < m && s[i] <= tail[j]) ? s[i++] : tail[j++];
+    if (dst != data)
+        memcpy(data, dst, n * sizeof (int32_t));
+
+    return 0;
+}
+
+//
+// Key and value pairs, as sort_kv_4si_sse2
+//
+//   len vectors of keys are followed by len vectors of their values.
+//   Pairs compare by key, then value.
+//
+
+static inline void minmax_kv_si_vec(vsi *ka, vsi *xa, vsi *kb, vsi *xb) {
+    vsi m = (*ka > *kb) | ((*ka == *kb) & (*xa > *xb));
+    vsi t = (*ka ^ *kb) & m;
+
+    *ka ^= t;
+    *kb ^= t;
+    t = (*xa ^ *xb) & m;
+    *xa ^= t;
+    *xb ^= t;
+}
+
+// As exchange_si_vec, for pairs
+static inline void exchange_kv_si_vec(vsi *k, vsi *x, int d, int kk) {
+    const vsi lane = { LANES_IOTA };
+    vsi lo = ((lane & d) == 0) == ((lane & kk) == 0);
+    vsi yk, yx, gt, lt, take;
+
+    partner_si_vec(&yk, k, d);
+    partner_si_vec(&yx, x, d);
+    gt = (*k > yk) | ((*k == yk) & (*x > yx));
+    lt = (yk > *k) | ((*k == yk) & (yx > *x));
+    take = (gt & lo) | (lt & ~lo);
+    *k ^= (*k ^ yk) & take;
+    *x ^= (*x ^ yx) & take;
+}
+
+static inline void sort_lanes_kv_si_vec(vsi *k, vsi *x) {
+    int kk, d;
+
+    for (kk = 2; kk <= VEC_WIDTH; kk *= 2)
+        for (d = kk / 2; d > 0; d /= 2)
+            exchange_kv_si_vec(k, x, d, kk);
+}
+
+#define EXCHANGE_KV_2(ka, xa, kb, xb, d) {                          \
+    vsi lk = SHUFFLE2(*ka, *kb, LANES_LO##d);                       \
+    vsi hk = SHUFFLE2(*ka, *kb, LANES_HI##d);                       \
+    vsi lx = SHUFFLE2(*xa, *xb, LANES_LO##d);                       \
+    vsi hx = SHUFFLE2(*xa, *xb, LANES_HI##d);                       \
+    minmax_kv_si_vec(&lk, &lx, &hk, &hx);                           \
+    *ka = SHUFFLE2(lk, hk, LANES_ZIPA##d);                          \
+    *kb = SHUFFLE2(lk, hk, LANES_ZIPB##d);                          \
+    *xa = SHUFFLE2(lx, hx, LANES_ZIPA##d);                          \
+    *xb = SHUFFLE2(lx, hx, LANES_ZIPB##d);                          \
+}
+
+// Bitonic sort of 2 sorted vectors of pairs, lowest half to a
+static inline void bitonic_sort_kv_si_vec(vsi *ka, vsi *xa, vsi *kb,
+        vsi *xb) {
+
+    *kb = SHUFFLE(*kb, LANES_REVERSE);
+    *xb = SHUFFLE(*xb, LANES_REVERSE);
+    minmax_kv_si_vec(ka, xa, kb, xb);
+#if VEC_WIDTH >= 16
+    EXCHANGE_KV_2(ka, xa, kb, xb, 8);
+#endif
+#if VEC_WIDTH >= 8
+    EXCHANGE_KV_2(ka, xa, kb, xb, 4);
+#endif
+    EXCHANGE_KV_2(ka, xa, kb, xb, 2);
+    EXCHANGE_KV_2(ka, xa, kb, xb, 1);
+
+}
+
+#undef EXCHANGE_KV_2
+
+// First pair of run 1 goes before first pair of run 2
+#define KV_BEFORE(k1, x1, k2, x2) \
+    ((k1)[0] < (k2)[0] || ((k1)[0] == (k2)[0] && (x1)[0] < (x2)[0]))
+
+// Merge 2 sorted runs of pairs, as merge_2run_vec
+static void merge_2run_kv_vec(vsi * restrict dk, vsi * restrict dx,
+        vsi *k1, vsi *x1, int len1, vsi *k2, vsi *x2, int len2) {
+    vsi ko1, xo1, ko2, xo2;
+    int i1 = 0, i2 = 0;
+
+    ko1 = k1[0];
+    xo1 = x1[i1++];
+    ko2 = k2[0];
+    xo2 = x2[i2++];
+    bitonic_sort_kv_si_vec(&ko1, &xo1, &ko2, &xo2);
+    *dk++ = ko1;
+    *dx++ = xo1;
+
+    while (i1 < len1 || i2 < len2) {
+
+        // Pick lowest (or the remaining run)
+        if (i2 == len2 || (i1 < len1 &&
+                KV_BEFORE(k1[i1], x1[i1], k2[i2], x2[i2]))) {
+            ko1 = k1[i1];
+            xo1 = x1[i1++];
+        } else {
+            ko1 = k2[i2];
+            xo1 = x2[i2++];
+        }
+
+        bitonic_sort_kv_si_vec(&ko1, &xo1, &ko2, &xo2);
+        *dk++ = ko1;
+        *dx++ = xo1;
+
+    }
+
+    *dk = ko2; // Last vector of pairs
+    *dx = xo2;
+
+}
+
+#undef KV_BEFORE
+
+// Sort a sequence of pairs
+//   Returns the buffer holding the sorted pairs (v or aux)
+vsi *sort_kv_si_vec(vsi *v, vsi *aux, int len) {
+    vsi *src = v, *dst = aux, *t;
+    int  i, w;
+
+    for (i = 0; i < len; i++)
+        sort_lanes_kv_si_vec(&v[i], &v[len + i]);
+
+    for (w = 1; w < len; w *= 2) {
+
+        for (i = 0; i < len; i += 2 * w) {
+            if (i + w >= len) { // Odd run out, copy
+                memcpy(&dst[i], &src[i], (len - i) * sizeof (vsi));
+                memcpy(&dst[len + i], &src[len + i],
+                        (len - i) * sizeof (vsi));
+            } else
+                merge_2run_kv_vec(&dst[i], &dst[len + i], &src[i],
+                        &src[len + i], w, &src[i + w], &src[len + i + w],
+                        (len - i - w) < w ? (len - i - w) : w);
+        }
+
+        t = src; // Swap buffers
+        src = dst;
+        dst = t;
+
+    }
+
+    return src;
+
+}
+
+//
+// Sorted set operations and partition, scalar
+//
+//   Same contracts as the SSE2 ones; only kept elements are written, so
+//   dst never needs room past the result.
+//
+
+// Remove duplicates of a sorted sequence, dst may be src
+int unique_i32_vec(int32_t *dst, const int32_t *src, int n) {
+    int i, k = 0;
+
+    for (i = 0; i < n; i++)
+        if (k == 0 || src[i] != dst[k - 1])
+            dst[k++] = src[i];
+
+    return k;
+}
+
+int intersect_i32_vec(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    int i = 0, j = 0, k = 0;
+
+    while (i < na && j < nb) {
+        if (a[i] < b[j])
+            i++;
+        else if (a[i] > b[j])
+            j++;
+        else {
+            dst[k++] = a[i++];
+            j++;
+        }
+    }
+
+    return k;
+}
+
+int difference_i32_vec(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    int i, j = 0, k = 0;
+
+    for (i = 0; i < na; i++) {
+        while (j < nb && b[j] < a[i])
+            j++;
+        if (j == nb || b[j] != a[i])
+            dst[k++] = a[i];
+    }
+
+    return k;
+}
+
+// Merge 2 sorted sequences, optionally removing duplicates
+int merge_i32_vec(int32_t * restrict dst, const int32_t *a, int na,
+        const int32_t *b, int nb, int unique) {
+    int32_t x;
+    int     i = 0, j = 0, k = 0;
+
+    while (i < na || j < nb) {
+        x = j == nb || (i < na && a[i] <= b[j]) ? a[i++] : b[j++];
+        if (!unique || k == 0 || x != dst[k - 1])
+            dst[k++] = x;
+    }
+
+    return k;
+}
+
+// Sort a sequence of vectors removing duplicates into dst (room for n)
+int sort_unique_si_vec(int32_t *dst, int n, vsi *v, vsi *aux, int len) {
+    (void) n; // Only distinct keys are written
+    return unique_i32_vec(dst, (int32_t *) sort_si_vec(v, aux, len),
+            len * VEC_WIDTH);
+}
+
+// Partition by pivot, elements < pivot first, returns their number
+int partition_i32_vec(int32_t *a, int n, int32_t pivot) {
+    int32_t x;
+    int     i = 0, j = n;
+
+    for (;;) {
+        while (i < j && a[i] < pivot)
+            i++;
+        while (i < j && a[j - 1] >= pivot)
+            j--;
+        if (j - i < 2)
+            break;
+        x = a[i];
+        a[i++] = a[--j];
+        a[j] = x;
+    }
+
+    return i;
+}
+
+#ifdef PZ_PORTABLE
+
+// The SSE2 kernels, vectors of both are 4 lanes
+void merge_2run_sse2(v4si * restrict dst, v4si * restrict src1, int len1,
+        v4si * restrict src2, int len2) {
+    merge_2run_vec((vsi *) dst, (vsi *) src1, len1, (vsi *) src2, len2);
+}
+v4si *sort_4si_sse2(v4si *v, v4si *aux, int len) {
+    return (v4si *) sort_si_vec((vsi *) v, (vsi *) aux, len);
+}
+v4si *sort_kv_4si_sse2(v4si *v, v4si *aux, int len) {
+    return (v4si *) sort_kv_si_vec((vsi *) v, (vsi *) aux, len);
+}
+int unique_i32_sse2(int32_t *dst, const int32_t *src, int n) {
+    return unique_i32_vec(dst, src, n);
+}
+int intersect_i32_sse2(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    return intersect_i32_vec(dst, a, na, b, nb);
+}
+int difference_i32_sse2(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb) {
+    return difference_i32_vec(dst, a, na, b, nb);
+}
+int merge_i32_sse2(int32_t * restrict dst, const int32_t *a, int na,
+        const int32_t *b, int nb, int unique) {
+    return merge_i32_vec(dst, a, na, b, nb, unique);
+}
+int sort_unique_4si_sse2(int32_t *dst, int n, v4si *v, v4si *aux, int len) {
+    return sort_unique_si_vec(dst, n, (vsi *) v, (vsi *) aux, len);
+}
+int partition_i32_sse2(int32_t *a, int n, int32_t pivot) {
+    return partition_i32_vec(a, n, pivot);
+}
+
+#endif
+
+#ifdef TEST
+
+// Vector extension test interfaces
+void pz_sort_lanes_si_vec(vsi *x) {
+    sort_lanes_si_vec(x);
+}
+void pz_bitonic_sort_si_vec(vsi *a, vsi *b) {
+    bitonic_sort_si_vec(a, b);
+}
+
+#endif
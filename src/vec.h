@@ -0,0 +1,62 @@
+//  PZ compressor, portable vector methods
+//  Copyright (C) 2008-2011  Alejo Sanchez www.ologan.com
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//  Vector primitives written only with GCC/Clang vector extensions
+//
+//  The width in 32bit lanes is fixed at compile time with VEC_WIDTH (4, 8
+//  or 16, e.g. -DVEC_WIDTH=8 -mavx2). Vectors only need 16 byte alignment,
+//  as the SSE2 ones, so the same buffers work for both.
+
+#ifndef PZ_VEC_H
+#define PZ_VEC_H
+
+#include <stdint.h>
+
+#ifndef VEC_WIDTH
+#define VEC_WIDTH 4
+#endif
+
+#if VEC_WIDTH != 4 && VEC_WIDTH != 8 && VEC_WIDTH != 16
+#error "VEC_WIDTH must be 4, 8 or 16"
+#endif
+
+// A vector of VEC_WIDTH 32bit signed integers
+typedef int32_t vsi __attribute__((vector_size(4 * VEC_WIDTH), aligned(16)));
+
+// Merge 2 sorted sequences of vectors of arbitrary (non zero) lengths
+void merge_2run_vec(vsi * restrict dst, vsi * restrict src1, int len1,
+        vsi * restrict src2, int len2);
+
+// Sort a sequence of vectors using aux as ping-pong buffer
+vsi *sort_si_vec(vsi *v, vsi *aux, int len);
+
+// Sort pairs by key then value, len vectors of keys followed by values
+vsi *sort_kv_si_vec(vsi *v, vsi *aux, int len);
+
+// Sorted set operations, as the SSE2 ones
+int unique_i32_vec(int32_t *dst, const int32_t *src, int n);
+int intersect_i32_vec(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb);
+int difference_i32_vec(int32_t *dst, const int32_t *a, int na,
+        const int32_t *b, int nb);
+int merge_i32_vec(int32_t * restrict dst, const int32_t *a, int na,
+        const int32_t *b, int nb, int unique);
+int sort_unique_si_vec(int32_t *dst, int n, vsi *v, vsi *aux, int len);
+
+// Partition by pivot, returns number of elements < pivot
+int partition_i32_vec(int32_t *a, int n, int32_t pivot);
+
+#endif